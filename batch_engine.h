@@ -0,0 +1,358 @@
+//
+//  batch_engine.h
+//  CF.STL_Ranges_00
+//
+//  Batch-at-a-time execution of filter / transform pipelines with
+//  selection vectors, in the style of vectorised query engines.
+//
+
+#ifndef batch_engine_h
+#define batch_engine_h
+
+#include <algorithm>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ranges>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "expr.h"
+
+namespace avi {
+namespace batch {
+
+//  MARK: - Batch Sizing
+/*
+ *  Default rows per batch.  1024 ints plus a 1024-entry selection
+ *  vector and one transform buffer fit comfortably in a 32 KiB L1.
+ */
+inline constexpr std::size_t default_batch_size = 1024;
+
+/*
+ *  Largest power of two such that batch rows of bytes_per_row
+ *  (values, selection and transform buffers together) fit in
+ *  cache_bytes.  For example fit_batch(32 * 1024, 12) == 2048.
+ */
+constexpr auto fit_batch(std::size_t cache_bytes, std::size_t bytes_per_row) -> std::size_t {
+  auto const rows = cache_bytes / std::max<std::size_t>(bytes_per_row, 1);
+  return rows < 64 ? 64 : std::bit_floor(rows);
+}
+
+struct options {
+  std::size_t batch_size = default_batch_size;
+};
+
+//  MARK: - Selection Vector
+/*
+ *  Which rows of the current batch are still live.  While no
+ *  filter has run the batch is dense and idx is not consulted.
+ */
+struct selection {
+  std::vector<std::uint32_t> idx;
+  std::size_t rows = 0;
+  std::size_t count = 0;
+  bool dense = true;
+
+  void reset(std::size_t n) {
+    rows = n;
+    count = n;
+    dense = true;
+  }
+};
+
+//  MARK: - Stages
+/*
+ *  Every stage has apply(values, sel, out) -> values'.  A filter
+ *  narrows sel and passes values through; a transform writes
+ *  fn(value) for the live rows into out at the same row
+ *  positions, so sel stays valid.  Transforms written as
+ *  avi::expr arithmetic (_1 + 1) use expr::transform_kernel on
+ *  dense int batches.  output_t<T> names the element
+ *  type a stage produces from T; the executor owns one buffer of
+ *  that type per stage.  Loops are written over plain arrays
+ *  without early exits so the compiler can vectorise them.
+ */
+template <typename Pred>
+struct filter_stage {
+  Pred pred;
+
+  static constexpr bool writes = false;
+
+  template <typename T>
+  using output_t = T;
+
+  template <typename T>
+  auto apply(T const * values, selection & sel, T *) -> T const * {
+    auto * const idx = sel.idx.data();
+    auto k = std::size_t { 0 };
+    if (sel.dense) {
+      for (auto i = std::size_t { 0 }; i < sel.rows; ++i) {
+        idx[k] = static_cast<std::uint32_t>(i);
+        k += static_cast<bool>(std::invoke(pred, values[i]));
+      }
+    }
+    else {
+      for (auto j = std::size_t { 0 }; j < sel.count; ++j) {
+        auto const i = idx[j];
+        idx[k] = i;
+        k += static_cast<bool>(std::invoke(pred, values[i]));
+      }
+    }
+    sel.dense = sel.dense && k == sel.rows;
+    sel.count = k;
+    return values;
+  }
+};
+
+template <typename Fn>
+struct transform_stage {
+  Fn fn;
+
+  static constexpr bool writes = true;
+
+  template <typename T>
+  using output_t = std::remove_cvref_t<std::invoke_result_t<Fn &, T const &>>;
+
+  template <typename T>
+  auto apply(T const * values, selection & sel, output_t<T> * dst) -> output_t<T> const * {
+    if constexpr (std::same_as<T, int> && std::same_as<output_t<T>, int>
+                  && expr::arithmetic_v<Fn>) {
+      if (sel.dense) {
+        expr::transform_kernel(values, sel.rows, dst, fn);
+        return dst;
+      }
+    }
+    if (sel.dense) {
+      for (auto i = std::size_t { 0 }; i < sel.rows; ++i) {
+        dst[i] = std::invoke(fn, values[i]);
+      }
+    }
+    else {
+      auto const * const idx = sel.idx.data();
+      for (auto j = std::size_t { 0 }; j < sel.count; ++j) {
+        auto const i = idx[j];
+        dst[i] = std::invoke(fn, values[i]);
+      }
+    }
+    return dst;
+  }
+};
+
+struct reverse_stage {
+  static constexpr bool writes = false;
+
+  template <typename T>
+  using output_t = T;
+
+  template <typename T>
+  auto apply(T const * values, selection &, T *) -> T const * { return values; }
+};
+
+namespace detail {
+
+/*
+ *  Per-stage output buffer types when T enters the first stage.
+ *  Stages that only pass values through (writes == false) leave
+ *  theirs empty.
+ */
+template <typename T, typename... Stages>
+struct buffers_of {
+  using type = std::tuple<>;
+  using output = T;
+};
+
+template <typename T, typename S, typename... Rest>
+struct buffers_of<T, S, Rest...> {
+  using next = typename S::template output_t<T>;
+  using rest = buffers_of<next, Rest...>;
+  using type = decltype(std::tuple_cat(std::declval<std::tuple<std::vector<next>>>(),
+                                       std::declval<typename rest::type>()));
+  using output = typename rest::output;
+};
+
+} /* namespace detail */
+
+//  MARK: - Pipeline
+template <typename... Stages>
+class pipeline {
+public:
+  pipeline(void) = default;
+  explicit pipeline(std::tuple<Stages...> stages) : stages_(std::move(stages)) {}
+
+  // Each reverse undoes the one before it: only the parity counts
+  static constexpr bool reversed =
+    ((std::is_same_v<Stages, reverse_stage> ? 1 : 0) + ... + 0) % 2 != 0;
+
+  template <typename T>
+  using buffers_t = typename detail::buffers_of<T, Stages...>::type;
+
+  template <typename T>
+  using output_t = typename detail::buffers_of<T, Stages...>::output;
+
+  /*
+   *  One output buffer per stage, batch_size rows each for the
+   *  stages that write.
+   */
+  template <typename T>
+  auto make_buffers(std::size_t batch_size) const -> buffers_t<T> {
+    auto buffers = buffers_t<T>();
+    [&]<std::size_t... I>(std::index_sequence<I...>) {
+      ((Stages::writes ? std::get<I>(buffers).resize(batch_size) : void()), ...);
+    }(std::index_sequence_for<Stages...>());
+    return buffers;
+  }
+
+  auto stages(void) && -> std::tuple<Stages...> && { return std::move(stages_); }
+  auto stages(void) const & -> std::tuple<Stages...> const & { return stages_; }
+
+  /*
+   *  Run every stage over one batch, then hand the surviving
+   *  values and the selection to sink.  A batch that filters down
+   *  to nothing stops early.
+   */
+  template <std::size_t I = 0, typename T, typename Buffers, typename Sink>
+  void run(T const * values, selection & sel, Buffers & buffers, Sink & sink) {
+    if constexpr (I == sizeof...(Stages)) {
+      sink(values, sel);
+    }
+    else {
+      auto const * next = std::get<I>(stages_).apply(values, sel, std::get<I>(buffers).data());
+      if (sel.count != 0) {
+        run<I + 1>(next, sel, buffers, sink);
+      }
+    }
+  }
+
+private:
+  std::tuple<Stages...> stages_;
+};
+
+namespace detail {
+
+template <typename T>
+struct is_pipeline : std::false_type {};
+
+template <typename... S>
+struct is_pipeline<pipeline<S...>> : std::true_type {};
+
+template <typename T>
+auto as_tuple(T && t) {
+  if constexpr (is_pipeline<std::remove_cvref_t<T>>::value) {
+    return std::forward<T>(t).stages();
+  }
+  else {
+    return std::make_tuple(std::forward<T>(t));
+  }
+}
+
+template <typename T>
+concept stage_like =
+  is_pipeline<std::remove_cvref_t<T>>::value
+  || std::is_same_v<std::remove_cvref_t<T>, reverse_stage>
+  || requires { typename std::remove_cvref_t<T>::batch_stage_tag; };
+
+template <typename Tuple>
+struct pipeline_from;
+
+template <typename... S>
+struct pipeline_from<std::tuple<S...>> {
+  using type = pipeline<S...>;
+};
+
+} /* namespace detail */
+
+/*
+ *  Stages and pipelines compose with |, mirroring std::views.
+ */
+template <typename A, typename B>
+  requires detail::stage_like<A> && detail::stage_like<B>
+auto operator|(A && a, B && b) {
+  auto joined = std::tuple_cat(detail::as_tuple(std::forward<A>(a)),
+                               detail::as_tuple(std::forward<B>(b)));
+  return typename detail::pipeline_from<decltype(joined)>::type(std::move(joined));
+}
+
+//  MARK: - Stage Factories
+template <typename Pred>
+struct filter_closure : filter_stage<Pred> {
+  using batch_stage_tag = void;
+};
+
+template <typename Fn>
+struct transform_closure : transform_stage<Fn> {
+  using batch_stage_tag = void;
+};
+
+template <typename Pred>
+auto filter(Pred pred) -> filter_closure<Pred> {
+  return filter_closure<Pred> { { std::move(pred) } };
+}
+
+template <typename Fn>
+auto transform(Fn fn) -> transform_closure<Fn> {
+  return transform_closure<Fn> { { std::move(fn) } };
+}
+
+inline constexpr reverse_stage reverse {};
+
+//  MARK: - Execution
+/*
+ *  execute(src, stages [, opts])
+ *
+ *  Run the pipeline over src in batches of opts.batch_size rows
+ *  and collect the results.  A reverse stage reverses the final
+ *  output, as views::reverse at the end of the chain would.
+ */
+template <std::ranges::contiguous_range R, typename P>
+  requires std::ranges::sized_range<R> && detail::stage_like<P>
+auto execute(R && src, P stages, options opts = {}) {
+  using pipe_type = typename detail::pipeline_from<
+    decltype(detail::as_tuple(std::move(stages)))>::type;
+  using in_type = std::ranges::range_value_t<R>;
+  using out_type = typename pipe_type::template output_t<in_type>;
+
+  auto pipe = pipe_type(detail::as_tuple(std::move(stages)));
+  auto const * const data = std::ranges::data(src);
+  auto const n = static_cast<std::size_t>(std::ranges::size(src));
+  auto const bs = std::max<std::size_t>(opts.batch_size, 1);
+
+  auto sel = selection {};
+  sel.idx.resize(bs);
+
+  auto buffers = pipe.template make_buffers<in_type>(bs);
+
+  auto results = std::vector<out_type>();
+  auto sink = [&](out_type const * values, selection const & s) {
+    if (s.dense) {
+      results.insert(results.end(), values, values + s.rows);
+    }
+    else {
+      auto const base = results.size();
+      results.resize(base + s.count);
+      auto * const dst = results.data() + base;
+      for (auto j = std::size_t { 0 }; j < s.count; ++j) {
+        dst[j] = values[s.idx[j]];
+      }
+    }
+  };
+
+  for (auto off = std::size_t { 0 }; off < n; off += bs) {
+    sel.reset(std::min(bs, n - off));
+    pipe.run(data + off, sel, buffers, sink);
+  }
+
+  if constexpr (pipe_type::reversed) {
+    std::ranges::reverse(results);
+  }
+  return results;
+}
+
+} /* namespace batch */
+} /* namespace avi */
+
+#endif /* batch_engine_h */
@@ -0,0 +1,597 @@
+//
+//  bench.cpp
+//  CF.STL_Ranges_00
+//
+//  Benchmarks for the show() sink, the filter | transform | reverse
+//  pipeline and use_for_each(), at input sizes from 1e3 up to the
+//  --max size (1e9 at most).
+//
+//  usage: bench [--min N] [--max N] [--reps R] [--warmup W]
+//               [--filter SUBSTR] [--json FILE]
+//
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <ranges>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "bench_harness.h"
+#include "fused_pipeline.h"
+#include "parallel_pipeline.h"
+#include "simd_filter.h"
+#include "format_sink.h"
+#include "mapped_array.h"
+#include "masked_update.h"
+#include "cached_filter.h"
+#include "batch_engine.h"
+#include "expr.h"
+#include "materialize.h"
+#include "chunk_generator.h"
+#include "stage_pipeline.h"
+#include "radix_sort.h"
+#include "reduce.h"
+#include "group_by.h"
+#include "join.h"
+#include "top_k.h"
+#include "distinct.h"
+
+namespace {
+
+//  MARK: - Workload Data
+/*
+ *  Uniformly distributed ints from a fixed-seed LCG, so the
+ *  is_even branch is unpredictable and runs are repeatable.
+ */
+auto make_data(std::size_t n) -> std::vector<int> {
+  auto data = std::vector<int>(n);
+  auto state = std::uint64_t { 0x9e3779b97f4a7c15ull };
+  for (auto & v : data) {
+    state = state * 6364136223846793005ull + 1442695040888963407ull;
+    v = static_cast<int>(state >> 40) - (1 << 23);
+  }
+  return data;
+}
+
+/*
+ *  The same LCG as a coroutine source, yielding chunk elements per
+ *  resume.  chunk == 1 is the per-element co_yield baseline.
+ */
+auto generate_data(std::size_t n, std::size_t chunk) -> avi::gen::chunk_generator<int> {
+  auto buffer = std::vector<int>(chunk);
+  auto state = std::uint64_t { 0x9e3779b97f4a7c15ull };
+  for (auto off = std::size_t { 0 }; off < n; off += chunk) {
+    auto const k = std::min(chunk, n - off);
+    for (auto j = std::size_t { 0 }; j < k; ++j) {
+      state = state * 6364136223846793005ull + 1442695040888963407ull;
+      buffer[j] = static_cast<int>(state >> 40) - (1 << 23);
+    }
+    co_yield std::span(buffer).first(k);
+  }
+}
+
+auto const is_even = [](auto const n) { return n % 2 == 0; };
+auto const increment = [](auto n) { return ++n; };
+
+//  MARK: - show()
+void bench_show(avi::bench::runner & r, std::vector<int> const & data) {
+  auto const n = data.size();
+
+  r.run("show/iostream", n, [&] {
+    auto null = std::ofstream("/dev/null");
+    for (auto const & v : data) {
+      null << std::setw(2) << v;
+    }
+    null << std::endl;
+  });
+
+  auto const fd = ::open("/dev/null", O_WRONLY);
+  {
+    auto sink = avi::format::fd_sink(fd);
+    r.run("show/fd_sink", n, [&] {
+      sink.print(data, 2);
+      sink.flush();
+    });
+  }
+  ::close(fd);
+
+  return;
+}
+
+//  MARK: - filter | transform | reverse
+void bench_pipeline(avi::bench::runner & r, std::vector<int> const & data) {
+  auto const n = data.size();
+
+  r.run("pipeline/lazy", n, [&] {
+    auto results = data
+         | std::views::filter(is_even)
+         | std::views::transform(increment)
+         | std::views::reverse;
+    auto sum = std::int64_t { 0 };
+    for (auto v : results) { sum += v; }
+    avi::bench::do_not_optimize(sum);
+  });
+
+  r.run("pipeline/fused", n, [&] {
+    auto results = data
+         | std::views::filter(is_even)
+         | std::views::transform(increment)
+         | std::views::reverse;
+    auto out = avi::fused::execute(results);
+    avi::bench::do_not_optimize(out.data());
+  });
+
+  r.run("pipeline/parallel", n, [&] {
+    auto out = avi::parallel::filter_transform(data, is_even, increment,
+                                               avi::parallel::order::reversed);
+    avi::bench::do_not_optimize(out.data());
+  });
+
+  // Every element of the first quarter passes the filter, so equal
+  // splits of the input are very unequal amounts of work
+  auto skewed = data;
+  for (auto & v : skewed | std::views::take(n / 4)) { v &= ~1; }
+  r.run("pipeline/parallel_skewed", n, [&] {
+    auto out = avi::parallel::filter_transform(skewed, is_even, increment,
+                                               avi::parallel::order::reversed);
+    avi::bench::do_not_optimize(out.data());
+  });
+
+  auto evens = std::vector<int>();
+  r.run("pipeline/filter_into", n, [&] {
+    avi::parallel::filter_into(data, evens, is_even, avi::parallel::order::reversed);
+    auto sum = std::int64_t { 0 };
+    for (auto v : evens | std::views::transform(increment)) { sum += v; }
+    avi::bench::do_not_optimize(sum);
+  });
+
+  r.run("pipeline/cached_filter", n, [&] {
+    auto results = data
+         | avi::cached_filter(is_even)
+         | std::views::transform(increment)
+         | std::views::reverse;
+    auto sum = std::int64_t { 0 };
+    for (auto v : results) { sum += v; }
+    avi::bench::do_not_optimize(sum);
+  });
+
+  r.run("pipeline/batch", n, [&] {
+    auto out = avi::batch::execute(data,
+                                   avi::batch::filter(is_even)
+                                   | avi::batch::transform(increment)
+                                   | avi::batch::reverse);
+    avi::bench::do_not_optimize(out.data());
+  });
+
+  r.run("pipeline/batch_expr", n, [&] {
+    using avi::expr::_1;
+    auto out = avi::batch::execute(data,
+                                   avi::batch::filter(_1 % 2 == 0)
+                                   | avi::batch::transform(_1 + 1)
+                                   | avi::batch::reverse);
+    avi::bench::do_not_optimize(out.data());
+  });
+
+  r.run("pipeline/simd_filter", n, [&] {
+    auto results = data
+         | avi::simd_filter(avi::simd::is_even {})
+         | std::views::transform(increment)
+         | std::views::reverse;
+    auto sum = std::int64_t { 0 };
+    for (auto v : results) { sum += v; }
+    avi::bench::do_not_optimize(sum);
+  });
+
+  r.run("pipeline/pipelined", n, [&] {
+    auto sum = std::int64_t { 0 };
+    avi::parallel::pipelined(data,
+                             avi::batch::filter(is_even)
+                             | avi::batch::transform(increment),
+                             [&](int v) { sum += v; });
+    avi::bench::do_not_optimize(sum);
+  });
+
+  for (auto const chunk : { std::size_t { 1 }, std::size_t { 4096 } }) {
+    r.run("pipeline/generator/" + std::to_string(chunk), n, [&] {
+      auto results = generate_data(n, chunk)
+           | std::views::filter(is_even)
+           | std::views::transform(increment);
+      auto sum = std::int64_t { 0 };
+      for (auto v : results) { sum += v; }
+      avi::bench::do_not_optimize(sum);
+    });
+  }
+
+  return;
+}
+
+//  MARK: - Small pipelines
+/*
+ *  Many short runs, each materialising its filtered stage and its
+ *  results: the cost is dominated by allocation, so the heap and
+ *  arena variants differ only in where the vectors come from.
+ */
+void bench_small(avi::bench::runner & r, std::vector<int> const & data) {
+  auto const n = data.size();
+  constexpr auto job = std::size_t { 256 };
+
+  r.run("small/heap", n, [&] {
+    auto sum = std::int64_t { 0 };
+    for (auto off = std::size_t { 0 }; off < n; off += job) {
+      auto const slice = std::span(data).subspan(off, std::min(job, n - off));
+      auto evens = std::vector<int>();
+      for (auto v : slice | std::views::filter(is_even)) { evens.push_back(v); }
+      auto out = std::vector<int>();
+      for (auto v : evens | std::views::transform(increment)) { out.push_back(v); }
+      sum += out.empty() ? 0 : out.back();
+    }
+    avi::bench::do_not_optimize(sum);
+  });
+
+  r.run("small/arena", n, [&] {
+    auto arena = avi::run_arena<4 * job * sizeof(int)>();
+    auto sum = std::int64_t { 0 };
+    for (auto off = std::size_t { 0 }; off < n; off += job) {
+      auto const slice = std::span(data).subspan(off, std::min(job, n - off));
+      {
+        auto evens = slice | std::views::filter(is_even) | avi::materialize(arena);
+        auto out = evens | std::views::transform(increment) | avi::materialize(arena);
+        sum += out.empty() ? 0 : out.back();
+      }
+      arena.release();
+    }
+    avi::bench::do_not_optimize(sum);
+  });
+
+  return;
+}
+
+//  MARK: - Memory-mapped source
+/*
+ *  The data is written to a scratch file once per size; the
+ *  timed region is the pipeline over the mapping (page cache hot).
+ */
+void bench_mapped(avi::bench::runner & r, std::vector<int> const & data) {
+  auto const n = data.size();
+  if (!r.selected("pipeline/mapped")) { return; }
+
+  char path[] = "/tmp/bench_mapped_XXXXXX";
+  auto const fd = ::mkstemp(path);
+  if (fd < 0) { return; }
+  auto const bytes = data.size() * sizeof(int);
+  auto const * p = reinterpret_cast<char const *>(data.data());
+  for (auto done = std::size_t { 0 }; done < bytes; ) {
+    auto const w = ::write(fd, p + done, bytes - done);
+    if (w <= 0) { break; }
+    done += static_cast<std::size_t>(w);
+  }
+  ::close(fd);
+
+  {
+    auto const mapped = avi::mapped::mapped_array<int>(path);
+    r.run("pipeline/mapped", n, [&] {
+      auto results = mapped
+           | std::views::filter(is_even)
+           | std::views::transform(increment);
+      auto sum = std::int64_t { 0 };
+      for (auto v : results) { sum += v; }
+      avi::bench::do_not_optimize(sum);
+    });
+  }
+  ::unlink(path);
+
+  return;
+}
+
+//  MARK: - use_for_each()
+void bench_for_each(avi::bench::runner & r, std::vector<int> const & data) {
+  auto const n = data.size();
+  auto work = std::vector<int>();
+
+  r.run("use_for_each/ranges", n,
+        [&] { work = data; },
+        [&] {
+          std::ranges::for_each(work | std::views::filter(is_even),
+                                [](int & i) { i += 1; });
+          avi::bench::do_not_optimize(work.data());
+        });
+
+  r.run("use_for_each/masked_update", n,
+        [&] { work = data; },
+        [&] {
+          avi::parallel::masked_update(work, is_even, increment);
+          avi::bench::do_not_optimize(work.data());
+        });
+
+  r.run("use_for_each/masked_add", n,
+        [&] { work = data; },
+        [&] {
+          avi::parallel::masked_add(work, avi::simd::is_even {}, 1);
+          avi::bench::do_not_optimize(work.data());
+        });
+
+  return;
+}
+
+auto parse_size(char const * text) -> std::size_t {
+  return static_cast<std::size_t>(std::strtod(text, nullptr));
+}
+
+//  MARK: - Reductions
+void bench_reduce(avi::bench::runner & r, std::vector<int> const & data) {
+  auto const n = data.size();
+
+  r.run("reduce/sum_loop", n, [&] {
+    auto sum = std::int64_t { 0 };
+    for (auto v : data | std::views::filter(is_even)) { sum += v; }
+    avi::bench::do_not_optimize(sum);
+  });
+
+  r.run("reduce/sum", n, [&] {
+    auto sum = data | std::views::filter(is_even) | avi::reduce::sum();
+    avi::bench::do_not_optimize(sum);
+  });
+
+  r.run("reduce/sum_simd_pred", n, [&] {
+    auto sum = data | std::views::filter(avi::simd::is_even {}) | avi::reduce::sum();
+    avi::bench::do_not_optimize(sum);
+  });
+
+  r.run("reduce/sum_transformed", n, [&] {
+    auto sum = data
+         | std::views::filter(is_even)
+         | std::views::transform(increment)
+         | avi::reduce::sum();
+    avi::bench::do_not_optimize(sum);
+  });
+
+  r.run("reduce/minmax", n, [&] {
+    auto mm = data | avi::reduce::minmax();
+    avi::bench::do_not_optimize(mm);
+  });
+
+  r.run("reduce/count", n, [&] {
+    auto count = data | std::views::filter(avi::simd::is_even {}) | avi::reduce::count();
+    avi::bench::do_not_optimize(count);
+  });
+
+  return;
+}
+
+//  MARK: - Group By
+/*
+ *  Summed and counted per key, with 1024 keys (the tables stay in
+ *  L1/L2) and with 1M keys (they do not).
+ */
+template <int Mask>
+void bench_group_keys(avi::bench::runner & r, std::vector<int> const & data, char const * suffix) {
+  auto const n = data.size();
+  auto const low_bits = [](int v) { return v & Mask; };
+
+  r.run("group/unordered_map/" + std::string(suffix), n, [&] {
+    auto groups = std::unordered_map<int, std::pair<std::int64_t, std::size_t>>();
+    for (auto v : data) {
+      auto & [sum, count] = groups[low_bits(v)];
+      sum += v;
+      ++count;
+    }
+    avi::bench::do_not_optimize(groups.size());
+  });
+
+  r.run("group/flat/" + std::string(suffix), n, [&] {
+    auto rows = data
+         | avi::group_by(low_bits)
+         | avi::aggregate(avi::reduce::sum(), avi::reduce::count());
+    avi::bench::do_not_optimize(rows.data());
+  });
+
+  return;
+}
+
+void bench_group(avi::bench::runner & r, std::vector<int> const & data) {
+  bench_group_keys<1023>(r, data, "1K");
+  bench_group_keys<0xFFFFF>(r, data, "1M");
+  return;
+}
+
+//  MARK: - Join
+/*
+ *  Every element looked up in a table of Keys (id, payload) rows:
+ *  1K rows stay in cache, 1M rows are partitioned.
+ */
+template <int Keys>
+void bench_join_keys(avi::bench::runner & r, std::vector<int> const & data, char const * suffix) {
+  auto const n = data.size();
+  auto dimension = std::vector<std::pair<int, int>>(Keys);
+  for (auto i = 0; i < Keys; ++i) { dimension[static_cast<std::size_t>(i)] = { i, i * 3 }; }
+  auto const id = [](int v) { return v & (Keys - 1); };
+
+  r.run("join/unordered_map/" + std::string(suffix), n, [&] {
+    auto table = std::unordered_map<int, std::pair<int, int>>();
+    for (auto const & row : dimension) { table.emplace(row.first, row); }
+    auto out = std::vector<std::pair<int, std::pair<int, int>>>();
+    for (auto v : data) {
+      if (auto it = table.find(id(v)); it != table.end()) { out.emplace_back(v, it->second); }
+    }
+    avi::bench::do_not_optimize(out.data());
+  });
+
+  r.run("join/flat/" + std::string(suffix), n, [&] {
+    auto out = data | avi::join(dimension, [](auto const & row) { return row.first; }, id);
+    avi::bench::do_not_optimize(out.data());
+  });
+
+  return;
+}
+
+void bench_join(avi::bench::runner & r, std::vector<int> const & data) {
+  bench_join_keys<1024>(r, data, "1K");
+  bench_join_keys<1024 * 1024>(r, data, "1M");
+  return;
+}
+
+//  MARK: - Top K
+void bench_top_k(avi::bench::runner & r, std::vector<int> const & data) {
+  auto const n = data.size();
+  constexpr auto k = std::size_t { 100 };
+
+  r.run("top_k/partial_sort_copy", n, [&] {
+    auto best = std::vector<int>(std::min(k, n));
+    std::ranges::partial_sort_copy(data | std::views::filter(is_even), best,
+                                   std::ranges::greater {});
+    avi::bench::do_not_optimize(best.data());
+  });
+
+  r.run("top_k/heap", n, [&] {
+    auto best = data | std::views::filter(is_even) | avi::top_k(k);
+    avi::bench::do_not_optimize(best.data());
+  });
+
+  r.run("top_k/heap_simd_pred", n, [&] {
+    auto best = data | std::views::filter(avi::simd::is_even {}) | avi::top_k(k);
+    avi::bench::do_not_optimize(best.data());
+  });
+
+  return;
+}
+
+//  MARK: - Distinct
+/*
+ *  An ingest-like stream: every value drawn from n / 5 keys, so
+ *  about 80% of elements repeat an earlier one.
+ */
+void bench_distinct(avi::bench::runner & r, std::vector<int> const & data) {
+  auto const n = data.size();
+  auto const keys = std::max<std::size_t>(n / 5, 1);
+  auto stream = std::vector<int>(n);
+  std::ranges::transform(data, stream.begin(), [&](int v) {
+    return static_cast<int>(static_cast<unsigned>(v) % keys);
+  });
+  auto sorted = stream;
+  std::ranges::sort(sorted);
+
+  r.run("distinct/unordered_set", n, [&] {
+    auto seen = std::unordered_set<int>();
+    auto out = std::size_t { 0 };
+    for (int v : stream) { out += seen.insert(v).second; }
+    avi::bench::do_not_optimize(&out);
+  });
+
+  r.run("distinct/flat", n, [&] {
+    auto out = std::size_t { 0 };
+    for (int v : stream | avi::distinct()) { out += static_cast<std::size_t>(v); }
+    avi::bench::do_not_optimize(&out);
+  });
+
+  r.run("distinct/sorted", n, [&] {
+    auto out = std::size_t { 0 };
+    for (int v : sorted | avi::distinct(avi::dedup::sorted)) { out += static_cast<std::size_t>(v); }
+    avi::bench::do_not_optimize(&out);
+  });
+
+  return;
+}
+
+//  MARK: - Sort
+void bench_sort(avi::bench::runner & r, std::vector<int> const & data) {
+  auto const n = data.size();
+  auto work = std::vector<int>();
+
+  r.run("sort/std", n,
+        [&] { work = data; },
+        [&] {
+          std::ranges::sort(work);
+          avi::bench::do_not_optimize(work.data());
+        });
+
+  r.run("sort/radix", n,
+        [&] { work = data; },
+        [&] {
+          avi::parallel::radix_sort(work);
+          avi::bench::do_not_optimize(work.data());
+        });
+
+  return;
+}
+
+} /* namespace */
+
+/*
+ *  MARK:  main()
+ */
+int main(int argc, char const * argv[]) {
+  auto opts = avi::bench::options {};
+  auto json_path = std::string();
+  auto emit = std::size_t { 0 };
+
+  for (auto i = 1; i < argc; ++i) {
+    auto const arg = std::string_view(argv[i]);
+    auto const has_value = i + 1 < argc;
+    if (arg == "--min" && has_value)         { opts.min_size = parse_size(argv[++i]); }
+    else if (arg == "--max" && has_value)    { opts.max_size = parse_size(argv[++i]); }
+    else if (arg == "--reps" && has_value)   { opts.reps = parse_size(argv[++i]); }
+    else if (arg == "--warmup" && has_value) { opts.warmup = parse_size(argv[++i]); }
+    else if (arg == "--filter" && has_value) { opts.filter = argv[++i]; }
+    else if (arg == "--json" && has_value)   { json_path = argv[++i]; }
+    else if (arg == "--emit" && has_value)   { emit = parse_size(argv[++i]); }
+    else {
+      std::cerr << "usage: " << argv[0]
+                << " [--min N] [--max N] [--reps R] [--warmup W]"
+                   " [--filter SUBSTR] [--json FILE]\n"
+                << "       " << argv[0] << " --emit N\n";
+      return 2;
+    }
+  }
+
+  // Write the benchmark data as text instead, e.g. to train a
+  // profile-guided build of main (see main-pgo in the Makefile)
+  if (emit != 0) {
+    auto sink = avi::format::fd_sink();
+    sink.print(make_data(emit), 9);  // |v| < 2^23: at least one space
+    return 0;
+  }
+  opts.max_size = std::min<std::size_t>(opts.max_size, 1'000'000'000);
+  opts.reps = std::max<std::size_t>(opts.reps, 1);
+
+  auto r = avi::bench::runner(opts);
+  for (auto const n : r.sizes()) {
+    auto const data = make_data(n);
+    bench_show(r, data);
+    bench_pipeline(r, data);
+    bench_small(r, data);
+    bench_mapped(r, data);
+    bench_for_each(r, data);
+    bench_reduce(r, data);
+    bench_group(r, data);
+    bench_join(r, data);
+    bench_top_k(r, data);
+    bench_distinct(r, data);
+    bench_sort(r, data);
+  }
+
+  if (json_path.empty() || json_path == "-") {
+    r.write_json(stdout);
+  }
+  else if (auto * out = std::fopen(json_path.c_str(), "w")) {
+    r.write_json(out);
+    std::fclose(out);
+  }
+  else {
+    std::perror(json_path.c_str());
+    return 1;
+  }
+
+  return 0;
+}
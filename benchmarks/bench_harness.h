@@ -0,0 +1,158 @@
+//
+//  bench_harness.h
+//  CF.STL_Ranges_00
+//
+//  Minimal self-contained benchmark harness: warmup, repetitions,
+//  order statistics and JSON output.
+//
+
+#ifndef bench_harness_h
+#define bench_harness_h
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace avi {
+namespace bench {
+
+//  MARK: - Optimisation Barriers
+/*
+ *  Keep the compiler from discarding a value or assuming memory
+ *  is unchanged across a measured region.
+ */
+template <typename T>
+inline
+void do_not_optimize(T const & value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+inline
+void clobber_memory(void) {
+  asm volatile("" : : : "memory");
+}
+
+//  MARK: - Configuration & Results
+struct options {
+  std::size_t min_size = 1'000;
+  std::size_t max_size = 10'000'000;
+  std::size_t warmup = 2;
+  std::size_t reps = 15;
+  std::string filter;
+};
+
+struct result {
+  std::string name;
+  std::size_t size = 0;
+  std::size_t reps = 0;
+  double min_ns = 0;
+  double median_ns = 0;
+  double p99_ns = 0;
+  double mean_ns = 0;
+};
+
+//  MARK: - Runner
+/*
+ *  runner
+ *
+ *  run(name, n, setup, body) calls setup() before every
+ *  repetition, outside the timed region, then times body().
+ *  Large inputs get fewer repetitions so that 1e9-element runs
+ *  finish in reasonable time.
+ */
+class runner {
+public:
+  explicit runner(options opts) : opts_(std::move(opts)) {}
+
+  auto sizes(void) const -> std::vector<std::size_t> {
+    auto out = std::vector<std::size_t>();
+    for (auto n = std::size_t { 1'000 }; n <= opts_.max_size; n *= 10) {
+      if (n >= opts_.min_size) { out.push_back(n); }
+    }
+    return out;
+  }
+
+  auto selected(std::string_view name) const -> bool {
+    return opts_.filter.empty() || name.find(opts_.filter) != std::string_view::npos;
+  }
+
+  template <typename Setup, typename Body>
+  void run(std::string_view name, std::size_t n, Setup && setup, Body && body) {
+    if (!selected(name)) { return; }
+
+    auto const reps = n >= 100'000'000 ? std::min<std::size_t>(opts_.reps, 3)
+                                       : opts_.reps;
+    for (auto w = std::size_t { 0 }; w < opts_.warmup; ++w) {
+      setup();
+      body();
+      clobber_memory();
+    }
+
+    auto samples = std::vector<double>();
+    samples.reserve(reps);
+    for (auto r = std::size_t { 0 }; r < reps; ++r) {
+      setup();
+      clobber_memory();
+      auto const t0 = std::chrono::steady_clock::now();
+      body();
+      clobber_memory();
+      auto const t1 = std::chrono::steady_clock::now();
+      samples.push_back(std::chrono::duration<double, std::nano>(t1 - t0).count());
+    }
+
+    std::ranges::sort(samples);
+    auto res = result {};
+    res.name = std::string(name);
+    res.size = n;
+    res.reps = reps;
+    res.min_ns = samples.front();
+    res.median_ns = samples[samples.size() / 2];
+    res.p99_ns = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+    auto sum = 0.0;
+    for (auto s : samples) { sum += s; }
+    res.mean_ns = sum / static_cast<double>(samples.size());
+
+    std::fprintf(stderr, "%-32s %12zu  median %14.0f ns  p99 %14.0f ns  %8.3f ns/elem\n",
+                 res.name.c_str(), n, res.median_ns, res.p99_ns,
+                 res.median_ns / static_cast<double>(n));
+    results_.push_back(std::move(res));
+    return;
+  }
+
+  template <typename Body>
+  void run(std::string_view name, std::size_t n, Body && body) {
+    run(name, n, [] {}, std::forward<Body>(body));
+  }
+
+  void write_json(std::FILE * out) const {
+    std::fputs("[\n", out);
+    for (auto i = std::size_t { 0 }; i < results_.size(); ++i) {
+      auto const & r = results_[i];
+      std::fprintf(out,
+                   "  {\"name\": \"%s\", \"size\": %zu, \"reps\": %zu, "
+                   "\"min_ns\": %.0f, \"median_ns\": %.0f, \"p99_ns\": %.0f, "
+                   "\"mean_ns\": %.0f}%s\n",
+                   r.name.c_str(), r.size, r.reps,
+                   r.min_ns, r.median_ns, r.p99_ns, r.mean_ns,
+                   i + 1 < results_.size() ? "," : "");
+    }
+    std::fputs("]\n", out);
+    return;
+  }
+
+private:
+  options opts_;
+  std::vector<result> results_;
+};
+
+} /* namespace bench */
+} /* namespace avi */
+
+#endif /* bench_harness_h */
@@ -0,0 +1,203 @@
+//
+//  cached_filter.h
+//  CF.STL_Ranges_00
+//
+//  Filter view that evaluates its predicate once per element and
+//  replays the selection on every later traversal.
+//
+
+#ifndef cached_filter_h
+#define cached_filter_h
+
+#include <compare>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <ranges>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "movable_box.h"
+#include "pipeline_stats.h"
+
+namespace avi {
+
+//  MARK: - View
+/*
+ *  cached_filter_view
+ *
+ *  The first call to begin() walks the source once and records
+ *  the index of every element that satisfies the predicate (the
+ *  selection vector).  The view is then a random-access range of
+ *  references into the source: forward and reverse passes, and
+ *  any number of repeated passes, are index lookups only.
+ *
+ *  Index is std::uint32_t by default, 4 bytes per selected
+ *  element; sources with more than 2^32 - 1 elements need
+ *  cached_filter<std::uint64_t>(pred).  The selection vector's
+ *  size is reported through a stats probe when one is named.
+ *
+ *  Copying or moving the view does not carry the selection over
+ *  (as std::views::filter drops its cached begin), so the copy
+ *  evaluates the predicate again when it is first traversed.
+ */
+template <std::ranges::view V, typename Pred, std::unsigned_integral Index = std::uint32_t>
+  requires std::ranges::random_access_range<V>
+        && std::ranges::sized_range<V>
+        && std::indirect_unary_predicate<Pred const, std::ranges::iterator_t<V>>
+class cached_filter_view
+  : public std::ranges::view_interface<cached_filter_view<V, Pred, Index>> {
+  using base_iterator = std::ranges::iterator_t<V>;
+
+public:
+  class iterator {
+  public:
+    using reference = std::ranges::range_reference_t<V>;
+    using iterator_concept = std::random_access_iterator_tag;
+    // As for transform_view: a prvalue reference only meets the
+    // C++17 input iterator requirements
+    using iterator_category = std::conditional_t<std::is_lvalue_reference_v<reference>,
+                                                 std::random_access_iterator_tag,
+                                                 std::input_iterator_tag>;
+    using value_type = std::ranges::range_value_t<V>;
+    using difference_type = std::ranges::range_difference_t<V>;
+
+    iterator(void) = default;
+    iterator(base_iterator first, Index const * pos) : first_(first), pos_(pos) {}
+
+    auto operator*(void) const -> reference { return first_[static_cast<difference_type>(*pos_)]; }
+    auto operator[](difference_type n) const -> reference {
+      return first_[static_cast<difference_type>(pos_[n])];
+    }
+
+    auto operator++(void) -> iterator & { ++pos_; return *this; }
+    auto operator++(int) -> iterator { auto t = *this; ++pos_; return t; }
+    auto operator--(void) -> iterator & { --pos_; return *this; }
+    auto operator--(int) -> iterator { auto t = *this; --pos_; return t; }
+    auto operator+=(difference_type n) -> iterator & { pos_ += n; return *this; }
+    auto operator-=(difference_type n) -> iterator & { pos_ -= n; return *this; }
+
+    friend auto operator+(iterator it, difference_type n) -> iterator { return it += n; }
+    friend auto operator+(difference_type n, iterator it) -> iterator { return it += n; }
+    friend auto operator-(iterator it, difference_type n) -> iterator { return it -= n; }
+    friend auto operator-(iterator const & a, iterator const & b) -> difference_type {
+      return static_cast<difference_type>(a.pos_ - b.pos_);
+    }
+    friend auto operator==(iterator const & a, iterator const & b) -> bool {
+      return a.pos_ == b.pos_;
+    }
+    friend auto operator<=>(iterator const & a, iterator const & b) -> std::strong_ordering {
+      return a.pos_ <=> b.pos_;
+    }
+
+  private:
+    base_iterator first_ = base_iterator();
+    Index const * pos_ = nullptr;
+  };
+
+  cached_filter_view(void) requires std::default_initializable<V>
+                                 && std::default_initializable<Pred> = default;
+  cached_filter_view(V base, Pred pred, stats::stage_probe probe = {})
+    : base_(std::move(base)), pred_(std::move(pred)), probe_(probe) {}
+
+  auto base(void) const & -> V requires std::copy_constructible<V> { return base_; }
+  auto base(void) && -> V { return std::move(base_); }
+  auto pred(void) const -> Pred const & { return *pred_; }
+
+  auto begin(void) -> iterator {
+    auto const & selected = select();
+    return iterator(std::ranges::begin(base_), selected.data());
+  }
+
+  auto end(void) -> iterator {
+    auto const & selected = select();
+    return iterator(std::ranges::begin(base_), selected.data() + selected.size());
+  }
+
+  auto size(void) -> std::size_t { return select().size(); }
+
+  /*
+   *  The selection vector, built on demand.
+   */
+  auto selection(void) -> std::vector<Index> const & { return select(); }
+
+private:
+  auto select(void) -> std::vector<Index> const & {
+    if (selected_.has_value()) { return *selected_; }
+
+    auto const n = static_cast<std::size_t>(std::ranges::size(base_));
+    if (n > std::numeric_limits<Index>::max()) {
+      throw std::length_error("avi::cached_filter: source too large for Index type");
+    }
+
+    auto & selected = selected_.emplace();
+    auto const first = std::ranges::begin(base_);
+    for (auto i = std::size_t { 0 }; i < n; ++i) {
+      if (std::invoke(*pred_, first[static_cast<std::ranges::range_difference_t<V>>(i)])) {
+        selected.push_back(static_cast<Index>(i));
+      }
+    }
+    selected.shrink_to_fit();
+
+    probe_.add_in(n);
+    probe_.add_pred_calls(n);
+    probe_.add_out(selected.size());
+    probe_.add_bytes(selected.capacity() * sizeof(Index));
+    return selected;
+  }
+
+  V base_ = V();
+  detail::movable_box<Pred> pred_;
+  [[no_unique_address]] stats::stage_probe probe_ = {};
+  // Not copied with the view, which keeps copies O(1): a copy
+  // builds its own selection on first use
+  detail::non_propagating_cache<std::vector<Index>> selected_;
+};
+
+template <typename R, typename Pred>
+cached_filter_view(R &&, Pred) -> cached_filter_view<std::views::all_t<R>, Pred>;
+
+template <typename R, typename Pred>
+cached_filter_view(R &&, Pred, stats::stage_probe)
+  -> cached_filter_view<std::views::all_t<R>, Pred>;
+
+//  MARK: - Adaptor
+/*
+ *  cached_filter(pred [, name])
+ *
+ *  Use in place of views::filter(pred) when the filtered range is
+ *  traversed more than once or in reverse.  With a name, and
+ *  statistics enabled, the stage's counts and selection-vector
+ *  memory appear in the stats report.
+ */
+template <typename Pred, std::unsigned_integral Index = std::uint32_t>
+struct cached_filter_closure {
+  Pred pred;
+  stats::stage_probe probe;
+
+  template <std::ranges::viewable_range R>
+  auto operator()(R && rng) const {
+    return cached_filter_view<std::views::all_t<R>, Pred, Index>(
+      std::views::all(std::forward<R>(rng)), pred, probe);
+  }
+
+  template <std::ranges::viewable_range R>
+  friend auto operator|(R && rng, cached_filter_closure const & self) {
+    return self(std::forward<R>(rng));
+  }
+};
+
+template <std::unsigned_integral Index = std::uint32_t, typename Pred>
+auto cached_filter(Pred pred, char const * name = nullptr)
+    -> cached_filter_closure<Pred, Index> {
+  return cached_filter_closure<Pred, Index> { std::move(pred), stats::make_probe(name) };
+}
+
+} /* namespace avi */
+
+#endif /* cached_filter_h */
@@ -0,0 +1,215 @@
+//
+//  chunk_generator.h
+//  CF.STL_Ranges_00
+//
+//  Coroutine generator that yields whole spans of elements and
+//  presents them as a flat input range.
+//
+
+#ifndef chunk_generator_h
+#define chunk_generator_h
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <ranges>
+#include <span>
+#include <utility>
+
+namespace avi {
+namespace gen {
+
+//  MARK: - Generator
+/*
+ *  chunk_generator
+ *
+ *  Return type for coroutines that produce data a chunk at a
+ *  time.  The body fills a buffer and co_yields a span over it:
+ *
+ *    auto countdown(int from) -> avi::gen::chunk_generator<int> {
+ *      auto buffer = std::array<int, 1024> {};
+ *      while (from > 0) {
+ *        auto k = std::size_t { 0 };
+ *        for (; k < buffer.size() && from > 0; ++k) { buffer[k] = from--; }
+ *        co_yield std::span(buffer).first(k);
+ *      }
+ *    }
+ *
+ *  Iterating the generator walks the elements of each span with
+ *  a plain pointer and only resumes the coroutine when a span is
+ *  used up, so the cost of a resume is spread over the whole
+ *  chunk.  The span (and the buffer behind it) need only stay
+ *  valid until the next resume, so one buffer can be refilled.
+ *  Empty spans are skipped.
+ *
+ *  Like std::generator this is a move-only, single-pass input
+ *  view: it goes straight into views::filter / views::transform
+ *  as a prvalue, but not through views::reverse.  chunks() gives
+ *  the spans themselves instead of the elements; use one or the
+ *  other, once.  An exception thrown by the body propagates from
+ *  begin() or operator++.
+ */
+template <typename T>
+class chunk_generator
+  : public std::ranges::view_interface<chunk_generator<T>> {
+public:
+  using chunk_type = std::span<T const>;
+
+  struct promise_type {
+    chunk_type chunk;
+    std::exception_ptr error;
+
+    auto get_return_object(void) -> chunk_generator {
+      return chunk_generator(handle_type::from_promise(*this));
+    }
+
+    auto initial_suspend(void) noexcept -> std::suspend_always { return {}; }
+    auto final_suspend(void) noexcept -> std::suspend_always { return {}; }
+
+    auto yield_value(chunk_type next) noexcept -> std::suspend_always {
+      chunk = next;
+      return {};
+    }
+
+    void return_void(void) noexcept {}
+    void unhandled_exception(void) { error = std::current_exception(); }
+
+    /*
+     *  co_yield is the only way to hand data out.
+     */
+    template <typename U>
+    auto await_transform(U &&) = delete;
+  };
+
+  using handle_type = std::coroutine_handle<promise_type>;
+
+  //  MARK: Element iterator
+  class iterator {
+  public:
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using iterator_concept = std::input_iterator_tag;
+
+    iterator(void) = default;
+    explicit iterator(handle_type coro) : coro_(coro) { next_chunk(); }
+
+    auto operator*(void) const -> T const & { return *cur_; }
+    auto operator++(void) -> iterator & {
+      if (++cur_ == last_) { next_chunk(); }
+      return *this;
+    }
+    void operator++(int) { ++*this; }
+
+    friend auto operator==(iterator const & it, std::default_sentinel_t) -> bool {
+      return it.cur_ == nullptr;
+    }
+
+  private:
+    void next_chunk(void) {
+      for (;;) {
+        auto const chunk = resume(coro_);
+        if (coro_.done()) {
+          cur_ = last_ = nullptr;
+          return;
+        }
+        if (!chunk.empty()) {
+          cur_ = chunk.data();
+          last_ = chunk.data() + chunk.size();
+          return;
+        }
+      }
+    }
+
+    handle_type coro_ = nullptr;
+    T const * cur_ = nullptr;
+    T const * last_ = nullptr;
+  };
+
+  //  MARK: Chunk view
+  class chunk_range : public std::ranges::view_interface<chunk_range> {
+  public:
+    class iterator {
+    public:
+      using value_type = chunk_type;
+      using difference_type = std::ptrdiff_t;
+      using iterator_concept = std::input_iterator_tag;
+
+      iterator(void) = default;
+      explicit iterator(handle_type coro) : coro_(coro), chunk_(resume(coro)) {}
+
+      auto operator*(void) const -> chunk_type { return chunk_; }
+      auto operator++(void) -> iterator & { chunk_ = resume(coro_); return *this; }
+      void operator++(int) { ++*this; }
+
+      friend auto operator==(iterator const & it, std::default_sentinel_t) -> bool {
+        return it.coro_.done();
+      }
+
+    private:
+      handle_type coro_ = nullptr;
+      chunk_type chunk_;
+    };
+
+    chunk_range(void) = default;
+    explicit chunk_range(handle_type coro) : coro_(coro) {}
+
+    auto begin(void) const -> iterator { return iterator(coro_); }
+    auto end(void) const -> std::default_sentinel_t { return {}; }
+
+  private:
+    handle_type coro_ = nullptr;
+  };
+
+  chunk_generator(void) = default;
+
+  chunk_generator(chunk_generator && other) noexcept
+    : coro_(std::exchange(other.coro_, nullptr)) {}
+
+  auto operator=(chunk_generator && other) noexcept -> chunk_generator & {
+    if (this != &other) {
+      destroy();
+      coro_ = std::exchange(other.coro_, nullptr);
+    }
+    return *this;
+  }
+
+  ~chunk_generator() { destroy(); }
+
+  auto begin(void) -> iterator { return iterator(coro_); }
+  auto end(void) const -> std::default_sentinel_t { return {}; }
+
+  /*
+   *  The yielded spans, one per resume.
+   */
+  auto chunks(void) -> chunk_range { return chunk_range(coro_); }
+
+private:
+  explicit chunk_generator(handle_type coro) : coro_(coro) {}
+
+  /*
+   *  Run the body to its next co_yield and return what it
+   *  yielded, or an empty span once it has finished.
+   */
+  static auto resume(handle_type coro) -> chunk_type {
+    coro.resume();
+    auto & promise = coro.promise();
+    if (coro.done()) {
+      if (promise.error) { std::rethrow_exception(std::exchange(promise.error, nullptr)); }
+      return {};
+    }
+    return promise.chunk;
+  }
+
+  void destroy(void) {
+    if (coro_) { coro_.destroy(); }
+    coro_ = nullptr;
+  }
+
+  handle_type coro_ = nullptr;
+};
+
+} /* namespace gen */
+} /* namespace avi */
+
+#endif /* chunk_generator_h */
@@ -0,0 +1,71 @@
+//
+//  compile_time.h
+//  CF.STL_Ranges_00
+//
+//  Compile-time evaluation of ranges pipelines over literal data.
+//
+
+#ifndef compile_time_h
+#define compile_time_h
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <ranges>
+#include <type_traits>
+
+namespace avi {
+namespace ct {
+
+namespace detail {
+
+template <auto const & Source, typename Pipeline>
+using result_view_t = std::invoke_result_t<Pipeline, decltype(Source)>;
+
+template <auto const & Source, typename Pipeline>
+consteval auto result_size(void) -> std::size_t {
+  auto view = Pipeline {}(Source);
+  return static_cast<std::size_t>(std::ranges::distance(view));
+}
+
+} /* namespace detail */
+
+//  MARK: - Evaluation
+/*
+ *  evaluate<source>(pipeline)
+ *
+ *  Run pipeline(source) entirely at compile time and return the
+ *  results as a std::array sized to fit, so the table is baked
+ *  into the binary and nothing runs at startup:
+ *
+ *    static constexpr auto numbers = std::array { 6, 5, 4, 3, 2, 1 };
+ *    constexpr auto results = avi::ct::evaluate<numbers>([](auto const & src) {
+ *      return src
+ *           | views::filter([](auto n) { return n % 2 == 0; })
+ *           | views::transform([](auto n) { return ++n; })
+ *           | views::reverse;
+ *    });
+ *
+ *  source must have static storage duration and pipeline must be
+ *  a captureless lambda (or any default-constructible callable):
+ *  it is re-created inside the constant evaluation, once to size
+ *  the result and once to fill it.
+ */
+template <auto const & Source, typename Pipeline>
+  requires std::default_initializable<Pipeline>
+        && std::ranges::input_range<detail::result_view_t<Source, Pipeline>>
+consteval auto evaluate(Pipeline) {
+  using value_type = std::ranges::range_value_t<detail::result_view_t<Source, Pipeline>>;
+  constexpr auto n = detail::result_size<Source, Pipeline>();
+
+  auto results = std::array<value_type, n> {};
+  auto view = Pipeline {}(Source);
+  std::ranges::copy(view, results.begin());
+  return results;
+}
+
+} /* namespace ct */
+} /* namespace avi */
+
+#endif /* compile_time_h */
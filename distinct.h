@@ -0,0 +1,249 @@
+//
+//  distinct.h
+//  CF.STL_Ranges_00
+//
+//  Lazy duplicate removal: a view that passes on only the first
+//  occurrence of every value.
+//
+
+#ifndef distinct_h
+#define distinct_h
+
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <ranges>
+#include <utility>
+
+#include "flat_table.h"
+#include "pipeline_stats.h"
+
+namespace avi {
+namespace dedup {
+
+/*
+ *  Tag for distinct(): the input is sorted (or at least has equal
+ *  values next to each other).
+ */
+struct sorted_t { explicit sorted_t(void) = default; };
+inline constexpr sorted_t sorted { };
+
+namespace detail {
+
+// Mapped type of the seen-set: only the keys matter
+struct unit {};
+
+} /* namespace detail */
+
+//  MARK: - Hashed View
+/*
+ *  distinct_view
+ *
+ *  Values seen so far are kept in an avi::flat::table, one copy of
+ *  each, so memory grows with the number of distinct values, not
+ *  the length of the stream.  An element costs one lookup: its
+ *  7-bit tag is matched against a group of sixteen control bytes,
+ *  and a key is compared only on a tag match, so a new value is
+ *  usually recognised without comparing any key, and a repeat
+ *  with one compare.
+ *
+ *  The view is single-pass: calling begin() again starts over with
+ *  an empty set.  Values must be hashable by avi::flat::hash_of
+ *  (std::hash) and copyable.
+ */
+template <std::ranges::view V>
+  requires std::ranges::input_range<V>
+        && std::equality_comparable<std::ranges::range_value_t<V>>
+        && std::copyable<std::ranges::range_value_t<V>>
+class distinct_view : public std::ranges::view_interface<distinct_view<V>> {
+  using base_iterator = std::ranges::iterator_t<V>;
+  using base_sentinel = std::ranges::sentinel_t<V>;
+  using value_type = std::ranges::range_value_t<V>;
+
+public:
+  class iterator {
+  public:
+    using iterator_concept = std::input_iterator_tag;
+    using value_type = std::ranges::range_value_t<V>;
+    using difference_type = std::ranges::range_difference_t<V>;
+
+    iterator(void) = default;
+    iterator(distinct_view * parent, base_iterator current)
+      : parent_(parent), current_(std::move(current)) { skip(); }
+
+    auto operator*(void) const -> std::ranges::range_reference_t<V> { return *current_; }
+
+    auto operator++(void) -> iterator & {
+      ++current_;
+      skip();
+      return *this;
+    }
+    void operator++(int) { ++*this; }
+
+    friend auto operator==(iterator const & it, std::default_sentinel_t) -> bool {
+      return it.done();
+    }
+
+  private:
+    auto done(void) const -> bool { return current_ == parent_->end_; }
+
+    // Move to the next element not seen before
+    void skip(void) {
+      while (!done() && !parent_->first_sighting(*current_)) { ++current_; }
+    }
+
+    distinct_view * parent_ = nullptr;
+    base_iterator current_ = base_iterator();
+  };
+
+  distinct_view(void) requires std::default_initializable<V> = default;
+  explicit distinct_view(V base, stats::stage_probe probe = {})
+    : base_(std::move(base)), probe_(probe) {}
+
+  auto base(void) const & -> V requires std::copy_constructible<V> { return base_; }
+  auto base(void) && -> V { return std::move(base_); }
+
+  auto begin(void) -> iterator {
+    seen_ = flat::table<value_type, detail::unit>();
+    end_ = std::ranges::end(base_);
+    return iterator(this, std::ranges::begin(base_));
+  }
+
+  auto end(void) const -> std::default_sentinel_t { return std::default_sentinel; }
+
+private:
+  auto first_sighting(value_type const & v) -> bool {
+    probe_.add_in(1);
+    if (!seen_.try_emplace(v).second) { return false; }
+    probe_.add_out(1);
+    return true;
+  }
+
+  V base_ = V();
+  [[no_unique_address]] stats::stage_probe probe_ = {};
+  flat::table<value_type, detail::unit> seen_;
+  base_sentinel end_ = base_sentinel();
+};
+
+template <typename R>
+distinct_view(R &&) -> distinct_view<std::views::all_t<R>>;
+
+//  MARK: - Sorted View
+/*
+ *  sorted_distinct_view
+ *
+ *  For input whose equal values are adjacent: an element is kept
+ *  when it differs from the one before it, so nothing is hashed
+ *  or stored.  A forward range when the source is one.
+ */
+template <std::ranges::view V>
+  requires std::ranges::forward_range<V>
+        && std::equality_comparable<std::ranges::range_value_t<V>>
+class sorted_distinct_view : public std::ranges::view_interface<sorted_distinct_view<V>> {
+  using base_iterator = std::ranges::iterator_t<V>;
+
+public:
+  class iterator {
+  public:
+    using iterator_concept = std::forward_iterator_tag;
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::ranges::range_value_t<V>;
+    using difference_type = std::ranges::range_difference_t<V>;
+
+    iterator(void) = default;
+    iterator(sorted_distinct_view * parent, base_iterator current)
+      : parent_(parent), current_(std::move(current)) {}
+
+    auto operator*(void) const -> std::ranges::range_reference_t<V> { return *current_; }
+
+    auto operator++(void) -> iterator & {
+      auto const last = std::ranges::end(parent_->base_);
+      auto next = std::ranges::next(current_);
+      while (next != last && *next == *current_) { ++next; }
+      parent_->probe_.add_in(static_cast<std::uint64_t>(std::ranges::distance(current_, next)));
+      parent_->probe_.add_out(1);
+      current_ = std::move(next);
+      return *this;
+    }
+    auto operator++(int) -> iterator { auto t = *this; ++*this; return t; }
+
+    friend auto operator==(iterator const & a, iterator const & b) -> bool {
+      return a.current_ == b.current_;
+    }
+    friend auto operator==(iterator const & it, std::default_sentinel_t) -> bool {
+      return it.done();
+    }
+
+  private:
+    auto done(void) const -> bool { return current_ == std::ranges::end(parent_->base_); }
+
+    sorted_distinct_view * parent_ = nullptr;
+    base_iterator current_ = base_iterator();
+  };
+
+  sorted_distinct_view(void) requires std::default_initializable<V> = default;
+  explicit sorted_distinct_view(V base, stats::stage_probe probe = {})
+    : base_(std::move(base)), probe_(probe) {}
+
+  auto base(void) const & -> V requires std::copy_constructible<V> { return base_; }
+  auto base(void) && -> V { return std::move(base_); }
+
+  auto begin(void) -> iterator { return iterator(this, std::ranges::begin(base_)); }
+  auto end(void) const -> std::default_sentinel_t { return std::default_sentinel; }
+
+private:
+  V base_ = V();
+  [[no_unique_address]] stats::stage_probe probe_ = {};
+};
+
+template <typename R>
+sorted_distinct_view(R &&) -> sorted_distinct_view<std::views::all_t<R>>;
+
+//  MARK: - Adaptor
+template <template <typename> class View>
+struct distinct_closure {
+  stats::stage_probe probe;
+
+  template <std::ranges::viewable_range R>
+  auto operator()(R && rng) const {
+    return View<std::views::all_t<R>>(std::views::all(std::forward<R>(rng)), probe);
+  }
+
+  template <std::ranges::viewable_range R>
+  friend auto operator|(R && rng, distinct_closure const & self) {
+    return self(std::forward<R>(rng));
+  }
+};
+
+} /* namespace dedup */
+
+/*
+ *  distinct([name])
+ *  distinct(dedup::sorted [, name])
+ *
+ *  Drop every element equal to one already passed on, keeping the
+ *  first occurrence and the stream's order:
+ *
+ *    auto fresh = ingest | avi::distinct() | views::transform(parse);
+ *    auto runs = sorted_ids | avi::distinct(avi::dedup::sorted);
+ *
+ *  The first form works on any input and remembers what it has
+ *  seen (see distinct_view); the second only compares neighbours.
+ *  With a name, and statistics enabled, the stage's in and out
+ *  counts appear in the stats report.
+ */
+inline
+auto distinct(char const * name = nullptr) -> dedup::distinct_closure<dedup::distinct_view> {
+  return { stats::make_probe(name) };
+}
+
+inline
+auto distinct(dedup::sorted_t, char const * name = nullptr)
+    -> dedup::distinct_closure<dedup::sorted_distinct_view> {
+  return { stats::make_probe(name) };
+}
+
+} /* namespace avi */
+
+#endif /* distinct_h */
@@ -0,0 +1,344 @@
+//
+//  expr.h
+//  CF.STL_Ranges_00
+//
+//  Inspectable predicate / transform expressions:
+//
+//    using avi::expr::_1;
+//    numbers | views::filter(_1 % 2 == 0) | views::transform(_1 + 1)
+//
+//  An expression is an ordinary callable, so it works anywhere a
+//  lambda does.  Unlike a lambda its structure is part of its
+//  type, so kernels can recognise it and pick a specialised
+//  implementation: `% 2^k == 0` becomes a bit test, and the int
+//  arithmetic and comparisons become AVX2 / AVX-512 instructions
+//  through mask() and vec().
+//
+
+#ifndef expr_h
+#define expr_h
+
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#   include <immintrin.h>
+#endif
+
+namespace avi {
+namespace expr {
+
+//  MARK: - Nodes
+struct node_base {};
+
+template <typename T>
+concept expression = std::derived_from<std::remove_cvref_t<T>, node_base>;
+
+/*
+ *  The argument placeholder.
+ */
+struct arg_t : node_base {
+  template <typename X>
+  constexpr auto operator()(X const & x) const -> X { return x; }
+};
+
+inline constexpr arg_t _1 {};
+
+template <typename T>
+struct constant : node_base {
+  T value;
+
+  constexpr explicit constant(T v) : value(v) {}
+
+  template <typename X>
+  constexpr auto operator()(X const &) const -> T { return value; }
+};
+
+//  Operation tags.
+struct plus_op        { static constexpr auto apply(auto a, auto b) { return a + b; } };
+struct minus_op       { static constexpr auto apply(auto a, auto b) { return a - b; } };
+struct times_op       { static constexpr auto apply(auto a, auto b) { return a * b; } };
+struct modulus_op     { static constexpr auto apply(auto a, auto b) { return a % b; } };
+struct bit_and_op     { static constexpr auto apply(auto a, auto b) { return a & b; } };
+struct equal_op       { static constexpr auto apply(auto a, auto b) -> bool { return a == b; } };
+struct not_equal_op   { static constexpr auto apply(auto a, auto b) -> bool { return a != b; } };
+struct less_op        { static constexpr auto apply(auto a, auto b) -> bool { return a < b; } };
+struct greater_op     { static constexpr auto apply(auto a, auto b) -> bool { return a > b; } };
+struct less_equal_op  { static constexpr auto apply(auto a, auto b) -> bool { return a <= b; } };
+struct greater_equal_op { static constexpr auto apply(auto a, auto b) -> bool { return a >= b; } };
+
+template <typename Op, typename L, typename R>
+struct binary;
+
+//  MARK: - Pattern Recognition
+/*
+ *  (x % m) == 0 and (x % m) != 0 with m a power of two are
+ *  (x & (m - 1)) == 0 and != 0 for every x, negative included.
+ *  The shape is known from the type; the constants are checked
+ *  when the expression is evaluated.
+ */
+template <typename E>
+struct is_divisibility_test : std::false_type {};
+
+template <typename Op, typename L, typename M, typename Z>
+  requires (std::same_as<Op, equal_op> || std::same_as<Op, not_equal_op>)
+        && std::integral<M> && std::integral<Z>
+struct is_divisibility_test<binary<Op, binary<modulus_op, L, constant<M>>, constant<Z>>>
+  : std::true_type {};
+
+/*
+ *  comparison<E>: E yields a truth value.  Its lane form is
+ *  all-ones / all-zeros where the scalar form is true / false.
+ */
+template <typename Op>
+inline constexpr bool comparison_op =
+  std::same_as<Op, equal_op> || std::same_as<Op, not_equal_op>
+  || std::same_as<Op, less_op> || std::same_as<Op, greater_op>
+  || std::same_as<Op, less_equal_op> || std::same_as<Op, greater_equal_op>;
+
+template <typename E>
+struct comparison : std::false_type {};
+
+template <typename Op, typename L, typename R>
+struct comparison<binary<Op, L, R>> : std::bool_constant<comparison_op<Op>> {};
+
+/*
+ *  vectorizable<E>: every node has an int32 lane form.  Only the
+ *  root may be a comparison: below it, a true lane would be -1 in
+ *  the vector form where the scalar form computes with 1, so
+ *  (_1 > 3) + 1 or (_1 > 3) == 1 stays scalar.
+ */
+template <typename E>
+struct vectorizable : std::false_type {};
+
+template <>
+struct vectorizable<arg_t> : std::true_type {};
+
+template <>
+struct vectorizable<constant<int>> : std::true_type {};
+
+template <typename Op, typename L, typename R>
+  requires (!std::same_as<Op, modulus_op>)
+struct vectorizable<binary<Op, L, R>>
+  : std::bool_constant<vectorizable<L>::value && vectorizable<R>::value
+                       && !comparison<L>::value && !comparison<R>::value> {};
+
+template <typename Op, typename L>
+  requires std::same_as<Op, equal_op> || std::same_as<Op, not_equal_op>
+struct vectorizable<binary<Op, binary<modulus_op, L, constant<int>>, constant<int>>>
+  : vectorizable<L> {};
+
+template <typename E>
+inline constexpr bool vectorizable_v = vectorizable<std::remove_cvref_t<E>>::value;
+
+/*
+ *  arithmetic_v<E>: vectorisable and built only from + - * &, so
+ *  vec() yields the same values as the scalar form (comparisons
+ *  yield -1 lanes where the scalar form yields true).
+ */
+template <typename E>
+struct arithmetic : std::false_type {};
+
+template <>
+struct arithmetic<arg_t> : std::true_type {};
+
+template <>
+struct arithmetic<constant<int>> : std::true_type {};
+
+template <typename Op, typename L, typename R>
+  requires std::same_as<Op, plus_op> || std::same_as<Op, minus_op>
+        || std::same_as<Op, times_op> || std::same_as<Op, bit_and_op>
+struct arithmetic<binary<Op, L, R>>
+  : std::bool_constant<arithmetic<L>::value && arithmetic<R>::value> {};
+
+template <typename E>
+inline constexpr bool arithmetic_v = arithmetic<std::remove_cvref_t<E>>::value;
+
+//  MARK: - Binary Node
+template <typename Op, typename L, typename R>
+struct binary : node_base {
+  L lhs;
+  R rhs;
+
+  constexpr binary(L l, R r) : lhs(std::move(l)), rhs(std::move(r)) {}
+
+  template <typename X>
+  constexpr auto operator()(X const & x) const {
+    if constexpr (is_divisibility_test<binary>::value) {
+      if constexpr (std::integral<decltype(lhs.lhs(x))>) {
+        auto const m = lhs.rhs.value;
+        if (m > 0 && (m & (m - 1)) == 0 && rhs.value == 0) {
+          auto const divisible = (lhs.lhs(x) & (m - 1)) == 0;
+          return std::same_as<Op, equal_op> ? divisible : !divisible;
+        }
+      }
+    }
+    return Op::apply(lhs(x), rhs(x));
+  }
+
+#ifdef __AVX2__
+  /*
+   *  Lane-wise evaluation over 8 int32 lanes.  Arithmetic nodes
+   *  return values, comparisons return all-ones / all-zeros lanes.
+   *  A divisibility test whose modulus turns out not to be a power
+   *  of two is evaluated one lane at a time.
+   */
+  auto vec(__m256i v) const -> __m256i requires vectorizable<binary>::value {
+    if constexpr (is_divisibility_test<binary>::value) {
+      auto const m = lhs.rhs.value;
+      auto const x = lower(lhs.lhs, v);
+      if (m > 0 && (m & (m - 1)) == 0 && rhs.value == 0) {
+        auto const low = _mm256_and_si256(x, _mm256_set1_epi32(m - 1));
+        auto const zero = _mm256_cmpeq_epi32(low, _mm256_setzero_si256());
+        if constexpr (std::same_as<Op, equal_op>) { return zero; }
+        else { return _mm256_xor_si256(zero, _mm256_set1_epi32(-1)); }
+      }
+      alignas(32) int in[8];
+      alignas(32) int out[8];
+      _mm256_store_si256(reinterpret_cast<__m256i *>(in), x);
+      for (auto j = 0; j < 8; ++j) {
+        out[j] = Op::apply(in[j] % m, rhs.value) ? -1 : 0;
+      }
+      return _mm256_load_si256(reinterpret_cast<__m256i const *>(out));
+    }
+    else {
+      auto const a = lower(lhs, v);
+      auto const b = lower(rhs, v);
+      if constexpr (std::same_as<Op, plus_op>)          { return _mm256_add_epi32(a, b); }
+      else if constexpr (std::same_as<Op, minus_op>)    { return _mm256_sub_epi32(a, b); }
+      else if constexpr (std::same_as<Op, times_op>)    { return _mm256_mullo_epi32(a, b); }
+      else if constexpr (std::same_as<Op, bit_and_op>)  { return _mm256_and_si256(a, b); }
+      else if constexpr (std::same_as<Op, equal_op>)    { return _mm256_cmpeq_epi32(a, b); }
+      else if constexpr (std::same_as<Op, not_equal_op>) {
+        return _mm256_xor_si256(_mm256_cmpeq_epi32(a, b), _mm256_set1_epi32(-1));
+      }
+      else if constexpr (std::same_as<Op, greater_op>)  { return _mm256_cmpgt_epi32(a, b); }
+      else if constexpr (std::same_as<Op, less_op>)     { return _mm256_cmpgt_epi32(b, a); }
+      else if constexpr (std::same_as<Op, less_equal_op>) {
+        return _mm256_xor_si256(_mm256_cmpgt_epi32(a, b), _mm256_set1_epi32(-1));
+      }
+      else {
+        static_assert(std::same_as<Op, greater_equal_op>);
+        return _mm256_xor_si256(_mm256_cmpgt_epi32(b, a), _mm256_set1_epi32(-1));
+      }
+    }
+  }
+
+  /*
+   *  Predicate form used by avi::simd_filter and masked_add:
+   *  all-ones lanes where the scalar form converts to true.  A
+   *  comparison's lanes already are; an arithmetic node's values
+   *  are tested against zero, as the conversion to bool does.
+   */
+  auto mask(__m256i v) const -> __m256i requires vectorizable<binary>::value {
+    if constexpr (comparison_op<Op>) { return vec(v); }
+    else {
+      auto const zero = _mm256_cmpeq_epi32(vec(v), _mm256_setzero_si256());
+      return _mm256_xor_si256(zero, _mm256_set1_epi32(-1));
+    }
+  }
+#endif  /* __AVX2__ */
+
+#if defined(__AVX512F__) && defined(__AVX2__)
+  auto mask(__m512i v) const -> __mmask16 requires vectorizable<binary>::value {
+    auto const lo = mask(_mm512_castsi512_si256(v));
+    auto const hi = mask(_mm512_extracti64x4_epi64(v, 1));
+    auto const bits_lo = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(lo)));
+    auto const bits_hi = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(hi)));
+    return static_cast<__mmask16>(bits_lo | (bits_hi << 8));
+  }
+#endif
+
+private:
+#ifdef __AVX2__
+  template <typename N>
+  static auto lower(N const & n, __m256i v) -> __m256i {
+    if constexpr (std::same_as<N, arg_t>)              { return v; }
+    else if constexpr (std::same_as<N, constant<int>>) { return _mm256_set1_epi32(n.value); }
+    else                                               { return n.vec(v); }
+  }
+#endif
+};
+
+//  MARK: - Operators
+namespace detail {
+
+template <typename T>
+constexpr auto as_node(T && t) {
+  if constexpr (expression<T>) {
+    return std::remove_cvref_t<T>(std::forward<T>(t));
+  }
+  else {
+    return constant<std::remove_cvref_t<T>>(std::forward<T>(t));
+  }
+}
+
+template <typename L, typename R>
+concept operands = (expression<L> || expression<R>)
+                && (expression<L> || std::is_arithmetic_v<std::remove_cvref_t<L>>)
+                && (expression<R> || std::is_arithmetic_v<std::remove_cvref_t<R>>);
+
+template <typename Op, typename L, typename R>
+constexpr auto make(L && l, R && r) {
+  auto a = as_node(std::forward<L>(l));
+  auto b = as_node(std::forward<R>(r));
+  return binary<Op, decltype(a), decltype(b)>(std::move(a), std::move(b));
+}
+
+} /* namespace detail */
+
+#define AVI_EXPR_BINARY_OPERATOR(SYM, OP) \
+  template <typename L, typename R> \
+    requires detail::operands<L, R> \
+  constexpr auto operator SYM(L && l, R && r) { \
+    return detail::make<OP>(std::forward<L>(l), std::forward<R>(r)); \
+  }
+
+AVI_EXPR_BINARY_OPERATOR(+,  plus_op)
+AVI_EXPR_BINARY_OPERATOR(-,  minus_op)
+AVI_EXPR_BINARY_OPERATOR(*,  times_op)
+AVI_EXPR_BINARY_OPERATOR(%,  modulus_op)
+AVI_EXPR_BINARY_OPERATOR(&,  bit_and_op)
+AVI_EXPR_BINARY_OPERATOR(==, equal_op)
+AVI_EXPR_BINARY_OPERATOR(!=, not_equal_op)
+AVI_EXPR_BINARY_OPERATOR(<,  less_op)
+AVI_EXPR_BINARY_OPERATOR(>,  greater_op)
+AVI_EXPR_BINARY_OPERATOR(<=, less_equal_op)
+AVI_EXPR_BINARY_OPERATOR(>=, greater_equal_op)
+
+#undef AVI_EXPR_BINARY_OPERATOR
+
+//  MARK: - Transform Kernel
+/*
+ *  transform_kernel()
+ *
+ *  dst[i] = fn(src[i]) over int arrays.  Arithmetic expressions
+ *  run 8 lanes at a time through vec(); anything else, including
+ *  plain lambdas, takes the scalar loop.
+ */
+template <typename Fn>
+inline
+void transform_kernel(int const * src, std::size_t n, int * dst, Fn const & fn) {
+  auto i = std::size_t { 0 };
+#ifdef __AVX2__
+  if constexpr (arithmetic_v<Fn> && !std::same_as<Fn, arg_t>
+                && !std::same_as<Fn, constant<int>>) {
+    for (; i + 8 <= n; i += 8) {
+      auto const v = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(src + i));
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), fn.vec(v));
+    }
+  }
+#endif
+  for (; i < n; ++i) {
+    dst[i] = static_cast<int>(std::invoke(fn, src[i]));
+  }
+  return;
+}
+
+} /* namespace expr */
+} /* namespace avi */
+
+#endif /* expr_h */
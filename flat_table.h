@@ -0,0 +1,249 @@
+//
+//  flat_table.h
+//  CF.STL_Ranges_00
+//
+//  Open-addressing hash table with keys and values in separate
+//  flat arrays.
+//
+
+#ifndef flat_table_h
+#define flat_table_h
+
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__)
+#   include <emmintrin.h>
+#endif
+
+namespace avi {
+namespace flat {
+
+//  MARK: - Hashing
+/*
+ *  64-bit finaliser (from SplitMix64).  Integer keys are mixed
+ *  directly; other keys go through std::hash first, which for
+ *  many standard types is the identity and would otherwise put
+ *  sequential keys in sequential slots.
+ */
+constexpr auto mix(std::uint64_t h) -> std::uint64_t {
+  h ^= h >> 30;
+  h *= 0xbf58476d1ce4e5b9ull;
+  h ^= h >> 27;
+  h *= 0x94d049bb133111ebull;
+  h ^= h >> 31;
+  return h;
+}
+
+template <typename K>
+auto hash_of(K const & key) -> std::uint64_t {
+  if constexpr (std::integral<K> || std::is_enum_v<K>) {
+    return mix(static_cast<std::uint64_t>(key));
+  }
+  else {
+    return mix(static_cast<std::uint64_t>(std::hash<K> {}(key)));
+  }
+}
+
+//  MARK: - Control Groups
+/*
+ *  Each slot has a control byte: 0 for empty, otherwise 0x80 | 7
+ *  bits of the key's hash.  match() compares a group of sixteen
+ *  control bytes against one value and returns a bit per slot
+ *  that equals it: one SSE2 compare where available.
+ */
+inline constexpr std::size_t group_width = 16;
+
+inline
+auto match(std::uint8_t const * group, std::uint8_t byte) -> std::uint32_t {
+#if defined(__SSE2__)
+  auto const ctrl = _mm_loadu_si128(reinterpret_cast<__m128i const *>(group));
+  auto const hits = _mm_cmpeq_epi8(ctrl, _mm_set1_epi8(static_cast<char>(byte)));
+  return static_cast<std::uint32_t>(_mm_movemask_epi8(hits));
+#else
+  auto bits = std::uint32_t { 0 };
+  for (auto i = std::size_t { 0 }; i < group_width; ++i) {
+    bits |= static_cast<std::uint32_t>(group[i] == byte) << i;
+  }
+  return bits;
+#endif
+}
+
+//  MARK: - Table
+/*
+ *  table
+ *
+ *  Open addressing in the style of Swiss tables.  Slots come in
+ *  groups of sixteen; a key's hash picks a starting group and a
+ *  7-bit tag, and a lookup probes one group at a time:
+ *  the tag is matched against all sixteen control bytes at once,
+ *  only matching slots have their keys compared, and a group with
+ *  an empty slot ends the search.  The table is kept at most 7/8
+ *  full, so nearly every lookup is settled in its first group
+ *  with one well-predicted branch.
+ *
+ *  Storage is three parallel arrays (control bytes, keys, values)
+ *  in plain heap blocks: a probe touches one cache line of control
+ *  bytes and then only the key and value it needs, there is no
+ *  per-entry allocation, and bool keys are bytes, not vector<bool>
+ *  bits.  There is no erase.  References into the table are
+ *  invalidated when it grows.  The key array is default-constructed
+ *  as a block and keys are assigned into it, so K must be regular:
+ *  default-constructible, copyable and equality-comparable.
+ */
+template <typename K, typename V>
+  requires std::regular<K> && std::default_initializable<V>
+class table {
+public:
+  using key_type = K;
+  using mapped_type = V;
+
+  table(void) = default;
+  explicit table(std::size_t expected) { reserve(expected); }
+
+  auto size(void) const -> std::size_t { return size_; }
+  auto empty(void) const -> bool { return size_ == 0; }
+  auto capacity(void) const -> std::size_t { return capacity_; }
+
+  /*
+   *  Make room for n entries without growing again.
+   */
+  void reserve(std::size_t n) {
+    auto const wanted = std::bit_ceil(std::max<std::size_t>(n + n / 7 + 1, group_width));
+    if (wanted > capacity()) { rehash(wanted); }
+  }
+
+  /*
+   *  The value for key, inserting a default-constructed one if it
+   *  is new.  second says whether it was inserted.
+   */
+  auto try_emplace(K const & key) -> std::pair<V &, bool> {
+    if ((size_ + 1) * 8 > capacity() * 7) {
+      rehash(std::max(capacity() * 2, group_width));
+    }
+    auto const h = hash_of(key);
+    auto const tag = tag_of(h);
+    auto const groups = capacity() / group_width;
+    for (auto g = static_cast<std::size_t>(h) & (groups - 1); ; g = (g + 1) & (groups - 1)) {
+      auto const base = g * group_width;
+      for (auto hits = match(ctrl_.get() + base, tag); hits != 0; hits &= hits - 1) {
+        auto const i = base + static_cast<std::size_t>(std::countr_zero(hits));
+        if (keys_[i] == key) { return { values_[i], false }; }
+      }
+      if (auto const free = match(ctrl_.get() + base, empty_slot); free != 0) {
+        auto const i = base + static_cast<std::size_t>(std::countr_zero(free));
+        ctrl_[i] = tag;
+        keys_[i] = key;
+        ++size_;
+        return { values_[i], true };
+      }
+    }
+  }
+
+  auto operator[](K const & key) -> V & { return try_emplace(key).first; }
+
+  auto find(K const & key) -> V * {
+    return const_cast<V *>(std::as_const(*this).find(key));
+  }
+
+  auto find(K const & key) const -> V const * { return find(key, hash_of(key)); }
+
+  /*
+   *  find() with hash_of(key) already computed, e.g. for a batch
+   *  of keys that were prefetched.
+   */
+  auto find(K const & key, std::uint64_t h) const -> V const * {
+    if (size_ == 0) { return nullptr; }
+    auto const tag = tag_of(h);
+    auto const groups = capacity() / group_width;
+    for (auto g = static_cast<std::size_t>(h) & (groups - 1); ; g = (g + 1) & (groups - 1)) {
+      auto const base = g * group_width;
+      for (auto hits = match(ctrl_.get() + base, tag); hits != 0; hits &= hits - 1) {
+        auto const i = base + static_cast<std::size_t>(std::countr_zero(hits));
+        if (keys_[i] == key) { return &values_[i]; }
+      }
+      if (match(ctrl_.get() + base, empty_slot) != 0) { return nullptr; }
+    }
+  }
+
+  /*
+   *  Pull the cache lines a lookup will touch first (the key's
+   *  first group of control bytes, keys and values) ahead of the
+   *  lookup itself.
+   */
+  void prefetch(K const & key) const { prefetch_hash(hash_of(key)); }
+
+  void prefetch_hash(std::uint64_t h) const {
+    if (capacity() == 0) { return; }
+    auto const groups = capacity() / group_width;
+    auto const base = (static_cast<std::size_t>(h) & (groups - 1)) * group_width;
+    __builtin_prefetch(ctrl_.get() + base);
+    __builtin_prefetch(keys_.get() + base);
+    __builtin_prefetch(values_.get() + base);
+  }
+
+  /*
+   *  fn(key, value) for every entry, in slot order.
+   */
+  template <typename Fn>
+  void for_each(Fn && fn) {
+    for (auto i = std::size_t { 0 }; i < capacity_; ++i) {
+      if (ctrl_[i] != empty_slot) { fn(keys_[i], values_[i]); }
+    }
+  }
+
+  template <typename Fn>
+  void for_each(Fn && fn) const {
+    for (auto i = std::size_t { 0 }; i < capacity_; ++i) {
+      if (ctrl_[i] != empty_slot) { fn(keys_[i], values_[i]); }
+    }
+  }
+
+private:
+  static constexpr std::uint8_t empty_slot = 0;
+
+  static auto tag_of(std::uint64_t h) -> std::uint8_t {
+    return static_cast<std::uint8_t>(0x80u | (h >> 57));
+  }
+
+  void rehash(std::size_t slots) {
+    auto ctrl = std::make_unique<std::uint8_t[]>(slots);
+    auto keys = std::make_unique<K[]>(slots);
+    auto values = std::make_unique<V[]>(slots);
+    auto const groups = slots / group_width;
+    for (auto j = std::size_t { 0 }; j < capacity_; ++j) {
+      if (ctrl_[j] == empty_slot) { continue; }
+      auto g = static_cast<std::size_t>(hash_of(keys_[j])) & (groups - 1);
+      auto free = match(ctrl.get() + g * group_width, empty_slot);
+      while (free == 0) {
+        g = (g + 1) & (groups - 1);
+        free = match(ctrl.get() + g * group_width, empty_slot);
+      }
+      auto const i = g * group_width + static_cast<std::size_t>(std::countr_zero(free));
+      ctrl[i] = ctrl_[j];
+      keys[i] = std::move(keys_[j]);
+      values[i] = std::move(values_[j]);
+    }
+    ctrl_ = std::move(ctrl);
+    keys_ = std::move(keys);
+    values_ = std::move(values);
+    capacity_ = slots;
+  }
+
+  std::unique_ptr<std::uint8_t[]> ctrl_;
+  std::unique_ptr<K[]> keys_;
+  std::unique_ptr<V[]> values_;
+  std::size_t capacity_ = 0;
+  std::size_t size_ = 0;
+};
+
+} /* namespace flat */
+} /* namespace avi */
+
+#endif /* flat_table_h */
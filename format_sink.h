@@ -0,0 +1,222 @@
+//
+//  format_sink.h
+//  CF.STL_Ranges_00
+//
+//  Buffered, locale-free formatting of ranges straight to a file
+//  descriptor.
+//
+
+#ifndef format_sink_h
+#define format_sink_h
+
+#include <cerrno>
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <ranges>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#include <unistd.h>
+
+namespace avi {
+namespace format {
+
+//  MARK: - Sink
+/*
+ *  fd_sink
+ *
+ *  Formats values with std::to_chars into a reusable buffer and
+ *  hands it to write(2) in blocks of block_size bytes.  Nothing
+ *  goes through iostream formatting and nothing is flushed per
+ *  element.
+ *
+ *  When the sink shares its descriptor with std::cout, call
+ *  flush() before writing to std::cout again; flush() in turn
+ *  drains std::cout first so the two never interleave.
+ */
+class fd_sink {
+public:
+  static constexpr std::size_t block_size = 64 * 1024;
+
+  explicit fd_sink(int fd = STDOUT_FILENO)
+    : fd_(fd), buffer_(new char[block_size + max_field]) {}
+
+  fd_sink(fd_sink const &) = delete;
+  auto operator=(fd_sink const &) -> fd_sink & = delete;
+
+  ~fd_sink() { flush(); }
+
+  /*
+   *  Append v right-aligned in a field of at least width chars,
+   *  as std::setw(width) would.
+   */
+  template <typename T>
+  void put(T const & v, std::size_t width = 0) {
+    if constexpr (std::is_arithmetic_v<T> && !std::is_same_v<T, bool>
+                  && !is_character<T>) {
+      put_number(v, width);
+    }
+    else if constexpr (is_narrow_character<T>) {
+      auto const c = static_cast<char>(v);
+      put_padded(std::string_view(&c, 1), width);
+    }
+    else if constexpr (std::is_convertible_v<T const &, std::string_view>) {
+      put_padded(std::string_view(v), width);
+    }
+    else {
+      auto os = std::ostringstream();
+      os << v;
+      put_padded(os.view(), width);
+    }
+  }
+
+  void put_char(char c) {
+    buffer_[used_++] = c;
+    if (used_ >= block_size) { drain(); }
+  }
+
+  /*
+   *  Every element of rng, each in a field of width chars, then a
+   *  newline.  Equivalent to the show() loop over setw(width).
+   */
+  template <std::ranges::input_range R>
+  void print(R && rng, std::size_t width = 2) {
+    for (auto const & v : rng) {
+      put(v, width);
+    }
+    put_char('\n');
+    return;
+  }
+
+  void flush(void) {
+    if (used_ != 0) { drain(); }
+    return;
+  }
+
+private:
+  static constexpr std::size_t max_field = 64;
+
+  /*
+   *  std::ostream prints signed and unsigned char (int8_t, uint8_t)
+   *  as characters, like char; the wide and Unicode character types
+   *  have deleted inserters and are left to the ostream fallback,
+   *  so they are rejected just as show() rejects them.
+   */
+  template <typename T>
+  static constexpr bool is_narrow_character =
+    std::is_same_v<T, char> || std::is_same_v<T, signed char>
+    || std::is_same_v<T, unsigned char>;
+
+  template <typename T>
+  static constexpr bool is_character =
+    is_narrow_character<T> || std::is_same_v<T, wchar_t> || std::is_same_v<T, char8_t>
+    || std::is_same_v<T, char16_t> || std::is_same_v<T, char32_t>;
+
+  /*
+   *  Floating point is written as %g with precision 6, which is what
+   *  std::ostream does by default, rather than to_chars' shortest
+   *  round-trip form, so the output matches show() digit for digit.
+   */
+  template <typename T>
+  static auto format_number(char * first, char * last, T v) -> std::to_chars_result {
+    if constexpr (std::is_floating_point_v<T>) {
+      return std::to_chars(first, last, v, std::chars_format::general, 6);
+    }
+    else {
+      return std::to_chars(first, last, v);
+    }
+  }
+
+  /*
+   *  Digits are generated in place and shifted right when the
+   *  field needs padding; the buffer always has max_field bytes
+   *  of room past block_size.
+   */
+  template <typename T>
+  void put_number(T const & v, std::size_t width) {
+    if (width > max_field / 2) {
+      char tmp[max_field];
+      auto const [ptr, ec] = format_number(tmp, tmp + sizeof tmp, v);
+      auto const len = ec == std::errc() ? static_cast<std::size_t>(ptr - tmp) : 0;
+      put_padded(std::string_view(tmp, len), width);
+      return;
+    }
+
+    auto * const first = buffer_.get() + used_;
+    auto const [ptr, ec] = format_number(first, first + max_field, v);
+    auto len = ec == std::errc() ? static_cast<std::size_t>(ptr - first) : 0;
+    if (len < width) {
+      std::memmove(first + (width - len), first, len);
+      std::memset(first, ' ', width - len);
+      len = width;
+    }
+    used_ += len;
+    if (used_ >= block_size) { drain(); }
+    return;
+  }
+
+  /*
+   *  Fields longer than max_field are written in pieces; every
+   *  append leaves used_ < block_size + max_field.
+   */
+  void put_padded(std::string_view text, std::size_t width) {
+    for (auto pad = width > text.size() ? width - text.size() : 0; pad > 0; ) {
+      auto const n = std::min(pad, max_field);
+      std::memset(buffer_.get() + used_, ' ', n);
+      used_ += n;
+      pad -= n;
+      if (used_ >= block_size) { drain(); }
+    }
+    while (!text.empty()) {
+      auto const n = std::min(text.size(), max_field);
+      std::memcpy(buffer_.get() + used_, text.data(), n);
+      used_ += n;
+      text.remove_prefix(n);
+      if (used_ >= block_size) { drain(); }
+    }
+    return;
+  }
+
+  void drain(void) {
+    if (fd_ == STDOUT_FILENO) { std::cout.flush(); }
+    auto const * p = buffer_.get();
+    auto left = used_;
+    while (left > 0) {
+      auto const n = ::write(fd_, p, left);
+      if (n < 0) {
+        if (errno == EINTR) { continue; }
+        break;
+      }
+      p += n;
+      left -= static_cast<std::size_t>(n);
+    }
+    used_ = 0;
+    return;
+  }
+
+  int fd_;
+  std::unique_ptr<char[]> buffer_;
+  std::size_t used_ = 0;
+};
+
+/*
+ *  Process-wide sink on standard output.
+ */
+inline
+auto stdout_sink(void) -> fd_sink & {
+  static auto sink = fd_sink(STDOUT_FILENO);
+  return sink;
+}
+
+} /* namespace format */
+} /* namespace avi */
+
+#endif /* format_sink_h */
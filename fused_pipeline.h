@@ -0,0 +1,133 @@
+//
+//  fused_pipeline.h
+//  CF.STL_Ranges_00
+//
+//  Single-pass execution of filter | transform [| reverse] chains.
+//
+
+#ifndef fused_pipeline_h
+#define fused_pipeline_h
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <iterator>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace avi {
+namespace fused {
+
+//  MARK: - Shape Detection
+namespace detail {
+
+template <typename T>
+struct filter_transform_shape : std::false_type {};
+
+template <typename V, typename P, typename F>
+struct filter_transform_shape<
+  std::ranges::transform_view<std::ranges::filter_view<V, P>, F>>
+  : std::true_type {
+  using source_type = V;
+};
+
+template <typename T>
+struct reversed_shape : std::false_type {
+  using forward_type = void;
+};
+
+template <typename V>
+struct reversed_shape<std::ranges::reverse_view<V>>
+  : filter_transform_shape<V> {
+  using forward_type = V;
+};
+
+/*
+ *  Upper bound on the number of elements a filter | transform
+ *  chain can produce: the size of the unfiltered source.
+ */
+template <typename TV>
+auto source_bound(TV const & tv) -> std::size_t {
+  auto fv = tv.base();
+  auto src = fv.base();
+  return static_cast<std::size_t>(std::ranges::size(src));
+}
+
+/*
+ *  The elements of rng in a vector reserved for bound of them,
+ *  trimmed afterwards if the filter kept less than half.
+ */
+template <typename R>
+auto collect(R & rng, std::size_t bound) -> std::vector<std::ranges::range_value_t<R>> {
+  auto storage = std::vector<std::ranges::range_value_t<R>>();
+  storage.reserve(bound);
+  for (auto && v : rng) {
+    storage.push_back(std::forward<decltype(v)>(v));
+  }
+  if (storage.size() < storage.capacity() / 2) { storage.shrink_to_fit(); }
+  return storage;
+}
+
+template <typename TV>
+concept sized_source =
+  filter_transform_shape<TV>::value
+  && std::ranges::sized_range<typename filter_transform_shape<TV>::source_type>
+  && std::copy_constructible<TV>;
+
+} /* namespace detail */
+
+//  MARK: - Executors
+/*
+ *  execute()
+ *
+ *  Materialize a pipeline into a vector.
+ *
+ *  reverse(transform(filter(src))) with a sized source is run as
+ *  one forward pass over the filter, appending each transformed
+ *  element to a buffer with room reserved for size(src), and the
+ *  selection is then reversed in place.  reverse_view over
+ *  filter_view would instead step the filter backwards, and since
+ *  reverse_iterator dereferences through a decremented copy, every
+ *  element's predicate search is run twice: once to read it and
+ *  once to move past it.
+ *
+ *  transform(filter(src)) is handled the same way, without the
+ *  reversal.  Reserving (rather than sizing) the buffer means a
+ *  selective filter writes only what it keeps, and the slack is
+ *  released once the pass is over.  Any other range is copied out
+ *  in iteration order.
+ */
+template <std::ranges::input_range R>
+auto execute(R && rng) -> std::vector<std::ranges::range_value_t<R>> {
+  using view_type = std::remove_cvref_t<R>;
+  using value_type = std::ranges::range_value_t<R>;
+
+  if constexpr (detail::reversed_shape<view_type>::value
+                && detail::sized_source<
+                     typename detail::reversed_shape<view_type>::forward_type>) {
+    auto forward = rng.base();
+    auto storage = detail::collect(forward, detail::source_bound(forward));
+    std::ranges::reverse(storage);
+    return storage;
+  }
+  else if constexpr (detail::sized_source<view_type>) {
+    return detail::collect(rng, detail::source_bound(rng));
+  }
+  else {
+    auto storage = std::vector<value_type>();
+    if constexpr (std::ranges::sized_range<R>) {
+      storage.reserve(static_cast<std::size_t>(std::ranges::size(rng)));
+    }
+    for (auto && v : rng) {
+      storage.push_back(std::forward<decltype(v)>(v));
+    }
+    return storage;
+  }
+}
+
+} /* namespace fused */
+} /* namespace avi */
+
+#endif /* fused_pipeline_h */
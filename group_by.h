@@ -0,0 +1,288 @@
+//
+//  group_by.h
+//  CF.STL_Ranges_00
+//
+//  Hash aggregation: group the elements of a range by a key and
+//  reduce every group with the reduce.h operations.
+//
+
+#ifndef group_by_h
+#define group_by_h
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <ranges>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "flat_table.h"
+#include "parallel_pipeline.h"
+#include "reduce.h"
+
+namespace avi {
+namespace group {
+
+namespace detail {
+
+//  MARK: - Aggregates
+/*
+ *  The reduce operation behind each terminal, for elements of T.
+ */
+template <typename Closure, typename T>
+struct op_of;
+
+template <typename T> struct op_of<reduce::sum_closure, T>    { using type = reduce::detail::sum_op<T>; };
+template <typename T> struct op_of<reduce::min_closure, T>    { using type = reduce::detail::min_op<T>; };
+template <typename T> struct op_of<reduce::max_closure, T>    { using type = reduce::detail::max_op<T>; };
+template <typename T> struct op_of<reduce::minmax_closure, T> { using type = reduce::detail::minmax_op<T>; };
+template <typename T> struct op_of<reduce::count_closure, T>  { using type = reduce::detail::count_op<T>; };
+
+template <typename Closure>
+concept aggregate_op = requires { typename op_of<Closure, int>::type; };
+
+/*
+ *  What one group has folded so far.  A group exists only once an
+ *  element has landed in it, so min and max are never empty and
+ *  are reported as plain values.
+ */
+template <typename T, typename... Ops>
+struct state {
+  std::tuple<typename Ops::acc_type...> accs;
+  std::size_t count = 0;
+
+  void start(void) { accs = { Ops::identity()... }; }
+
+  void step(T const & v) {
+    [&]<std::size_t... I>(std::index_sequence<I...>) {
+      ((std::get<I>(accs) = Ops::step(std::get<I>(accs), v)), ...);
+    }(std::index_sequence_for<Ops...> {});
+    ++count;
+  }
+
+  void merge(state const & other) {
+    [&]<std::size_t... I>(std::index_sequence<I...>) {
+      ((std::get<I>(accs) = Ops::combine(std::get<I>(accs), std::get<I>(other.accs))), ...);
+    }(std::index_sequence_for<Ops...> {});
+    count += other.count;
+  }
+
+  template <std::size_t I>
+  auto result(void) const {
+    using op = std::tuple_element_t<I, std::tuple<Ops...>>;
+    if constexpr (std::same_as<op, reduce::detail::count_op<T>>) { return count; }
+    else { return std::get<I>(accs); }
+  }
+};
+
+/*
+ *  (key, result of each op) for one group.
+ */
+template <typename K, typename State, typename Seq>
+struct row_of;
+
+template <typename K, typename State, std::size_t... I>
+struct row_of<K, State, std::index_sequence<I...>> {
+  using type = std::tuple<K, decltype(std::declval<State const &>().template result<I>())...>;
+};
+
+template <typename K, typename T, typename... Ops>
+using table_for = flat::table<K, state<T, Ops...>>;
+
+//  MARK: - Build
+template <typename Table, typename KeyFn, typename T>
+void insert(Table & table, KeyFn & key, T const & v) {
+  auto [group, fresh] = table.try_emplace(std::invoke(key, v));
+  if (fresh) { group.start(); }
+  group.step(v);
+}
+
+/*
+ *  Fold every entry of from into into.
+ */
+template <typename Table>
+void merge_into(Table & into, Table const & from) {
+  from.for_each([&](auto const & k, auto const & group) {
+    auto [mine, fresh] = into.try_emplace(k);
+    if (fresh) { mine = group; }
+    else { mine.merge(group); }
+  });
+}
+
+/*
+ *  One partial table per worker over a contiguous share of the
+ *  source, built in parallel, then merged pairwise as a tree, with
+ *  the merges of each level also in parallel.  Partials are per
+ *  worker rather than per chunk: a table is as large as the
+ *  number of distinct keys, not the share of input it saw.
+ */
+template <typename Table, typename Src, typename KeyFn, typename Pred>
+auto build_parallel(Src & src, KeyFn & key, Pred const & pred) -> Table {
+  auto const n = static_cast<std::size_t>(std::ranges::size(src));
+  auto const parts = std::min(parallel::chunk_count(n), parallel::worker_count());
+  auto tables = std::vector<Table>(parts);
+  auto const first = std::ranges::begin(src);
+
+  parallel::for_each_chunk(parts, [&](std::size_t c) {
+    // Built in a local, not in place in tables: stores to the
+    // accumulators could otherwise alias the table's own fields,
+    // forcing them to be reloaded for every element
+    auto local_key = key;
+    auto table = Table();
+    auto const last = first + static_cast<std::ptrdiff_t>(n * (c + 1) / parts);
+    for (auto it = first + static_cast<std::ptrdiff_t>(n * c / parts); it != last; ++it) {
+      auto && v = *it;
+      if (std::invoke(pred, v)) { insert(table, local_key, v); }
+    }
+    tables[c] = std::move(table);
+  });
+
+  for (auto stride = std::size_t { 1 }; stride < parts; stride *= 2) {
+    auto const pairs = (parts - stride + 2 * stride - 1) / (2 * stride);
+    parallel::for_each_chunk(pairs, [&](std::size_t p) {
+      auto const c = p * 2 * stride;
+      merge_into(tables[c], tables[c + stride]);
+      tables[c + stride] = Table();
+    });
+  }
+  return std::move(tables[0]);
+}
+
+/*
+ *  Build the table for rng:
+ *
+ *    sized random-access                              in parallel
+ *    views::filter over a sized random-access base    in parallel,
+ *        the predicate applied while scanning
+ *    anything else, or sequential                     in one pass
+ */
+template <typename Table, typename R, typename KeyFn>
+auto build(R & rng, KeyFn & key, bool sequential) -> Table {
+  if constexpr (std::ranges::random_access_range<R> && std::ranges::sized_range<R>) {
+    if (!sequential) { return build_parallel<Table>(rng, key, reduce::detail::keep_all {}); }
+  }
+  else if constexpr (reduce::detail::splittable_filter<R>) {
+    if (!sequential) {
+      auto base = rng.base();
+      return build_parallel<Table>(base, key, rng.pred());
+    }
+  }
+  auto table = Table();
+  for (auto && v : rng) { insert(table, key, v); }
+  return table;
+}
+
+} /* namespace detail */
+
+//  MARK: - Stages
+/*
+ *  A range waiting for its aggregates; see group_by().
+ */
+template <std::ranges::input_range V, typename KeyFn>
+  requires std::ranges::view<V>
+struct grouped {
+  V base;
+  KeyFn key;
+  bool sequential = false;
+};
+
+template <typename KeyFn>
+struct group_by_closure {
+  KeyFn key;
+  bool sequential = false;
+
+  template <std::ranges::viewable_range R>
+    requires std::ranges::input_range<R>
+  friend auto operator|(R && rng, group_by_closure const & self) {
+    return grouped<std::views::all_t<R>, KeyFn> { std::views::all(std::forward<R>(rng)), self.key,
+                                                  self.sequential };
+  }
+};
+
+/*
+ *  aggregate(terminals...)
+ *
+ *  Runs the grouping: one row per distinct key, the key first and
+ *  then one value per terminal, in the order given.
+ */
+template <detail::aggregate_op... Closures>
+struct aggregate_closure {
+  template <typename V, typename KeyFn>
+  auto operator()(grouped<V, KeyFn> g) const {
+    using value_type = std::ranges::range_value_t<V>;
+    using key_type = std::remove_cvref_t<std::invoke_result_t<KeyFn &, value_type const &>>;
+    using table_type = detail::table_for<key_type, value_type,
+                                         typename detail::op_of<Closures, value_type>::type...>;
+
+    auto table = detail::build<table_type>(g.base, g.key, g.sequential);
+
+    using row_type = typename detail::row_of<key_type, typename table_type::mapped_type,
+                                             std::index_sequence_for<Closures...>>::type;
+
+    auto rows = std::vector<row_type>();
+    rows.reserve(table.size());
+    table.for_each([&](key_type const & k, auto const & group) {
+      [&]<std::size_t... I>(std::index_sequence<I...>) {
+        rows.emplace_back(k, group.template result<I>()...);
+      }(std::index_sequence_for<Closures...> {});
+    });
+
+    if constexpr (std::totally_ordered<key_type>) {
+      std::ranges::sort(rows, std::ranges::less {}, [](auto const & row) -> key_type const & {
+        return std::get<0>(row);
+      });
+    }
+    return rows;
+  }
+
+  template <typename V, typename KeyFn>
+  friend auto operator|(grouped<V, KeyFn> g, aggregate_closure const & self) {
+    return self(std::move(g));
+  }
+};
+
+} /* namespace group */
+
+/*
+ *  group_by(key) | aggregate(terminals...)
+ *
+ *  Hash aggregation at the end of a pipeline:
+ *
+ *    auto rows = numbers
+ *         | views::filter(is_positive)
+ *         | avi::group_by([](int n) { return n % 10; })
+ *         | avi::aggregate(avi::reduce::sum(), avi::reduce::count());
+ *
+ *  gives a std::vector<std::tuple<int, int64_t, size_t>>, one
+ *  (key, sum, count) row per last digit, sorted by key when keys
+ *  are ordered.  Groups live in an avi::flat::table.  Sized random-
+ *  access ranges, and views::filter over one, are grouped with one
+ *  table per worker and the tables merged at the end; other ranges
+ *  in a single pass.
+ *
+ *  Grouped per worker, key, the filter's predicate and any
+ *  transform behind a random-access range run on several threads
+ *  at once: they must be thread-safe and free of side effects.
+ *  group_by(seq, key) groups on the calling thread alone.
+ */
+template <typename KeyFn>
+auto group_by(KeyFn key) -> group::group_by_closure<KeyFn> {
+  return { std::move(key) };
+}
+
+template <typename KeyFn>
+auto group_by(parallel::sequenced_policy, KeyFn key) -> group::group_by_closure<KeyFn> {
+  return { std::move(key), true };
+}
+
+template <group::detail::aggregate_op... Closures>
+auto aggregate(Closures...) -> group::aggregate_closure<Closures...> {
+  return {};
+}
+
+} /* namespace avi */
+
+#endif /* group_by_h */
@@ -0,0 +1,213 @@
+//
+//  int_stream.h
+//  CF.STL_Ranges_00
+//
+//  Chunked streaming source of integers read from a file
+//  descriptor, exposed as an input range.
+//
+
+#ifndef int_stream_h
+#define int_stream_h
+
+#include <cerrno>
+#include <charconv>
+#include <concepts>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <ranges>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace avi {
+namespace stream {
+
+//  MARK: - Stream View
+/*
+ *  basic_int_stream
+ *
+ *  Reads whitespace- (or comma-) separated integers from a file
+ *  descriptor chunk_size bytes at a time and yields them one by
+ *  one.  Only one chunk is ever held, so memory use does not
+ *  depend on the size of the input.  A token split across two
+ *  reads is carried over to the front of the buffer.
+ *
+ *  This is a single-pass input view: begin() may be called once,
+ *  and stages that need to walk backwards (views::reverse) do not
+ *  apply.  Malformed tokens and read errors throw.
+ */
+template <std::integral T>
+class basic_int_stream
+  : public std::ranges::view_interface<basic_int_stream<T>> {
+public:
+  static constexpr std::size_t chunk_size = 64 * 1024;
+
+  class iterator {
+  public:
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using iterator_concept = std::input_iterator_tag;
+
+    iterator(void) = default;
+    explicit iterator(basic_int_stream * parent) : parent_(parent) {}
+
+    auto operator*(void) const -> T { return parent_->current_; }
+    auto operator++(void) -> iterator & { parent_->advance(); return *this; }
+    void operator++(int) { ++*this; }
+
+    friend auto operator==(iterator const & it, std::default_sentinel_t) -> bool {
+      return it.at_end();
+    }
+
+  private:
+    auto at_end(void) const -> bool { return parent_->done_; }
+
+    basic_int_stream * parent_ = nullptr;
+  };
+
+  explicit basic_int_stream(int fd, bool owns_fd = false)
+    : fd_(fd), owns_fd_(owns_fd), buffer_(new char[chunk_size]) {}
+
+  /*
+   *  "-" reads standard input; anything else is opened as a file.
+   */
+  static auto open(std::string const & source) -> basic_int_stream {
+    if (source == "-") {
+      return basic_int_stream(STDIN_FILENO);
+    }
+    auto const fd = ::open(source.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      throw std::system_error(errno, std::generic_category(), source);
+    }
+    return basic_int_stream(fd, true);
+  }
+
+  basic_int_stream(basic_int_stream && other) noexcept
+    : fd_(std::exchange(other.fd_, -1)),
+      owns_fd_(std::exchange(other.owns_fd_, false)),
+      buffer_(std::move(other.buffer_)),
+      pos_(other.pos_), len_(other.len_),
+      input_eof_(other.input_eof_), done_(other.done_),
+      current_(other.current_) {}
+
+  auto operator=(basic_int_stream && other) noexcept -> basic_int_stream & {
+    if (this != &other) {
+      close();
+      fd_ = std::exchange(other.fd_, -1);
+      owns_fd_ = std::exchange(other.owns_fd_, false);
+      buffer_ = std::move(other.buffer_);
+      pos_ = other.pos_;
+      len_ = other.len_;
+      input_eof_ = other.input_eof_;
+      done_ = other.done_;
+      current_ = other.current_;
+    }
+    return *this;
+  }
+
+  ~basic_int_stream() { close(); }
+
+  auto begin(void) -> iterator {
+    advance();
+    return iterator(this);
+  }
+
+  auto end(void) const -> std::default_sentinel_t { return {}; }
+
+private:
+  /*
+   *  Whitespace and commas separate tokens; every other character
+   *  belongs to one, so "12abc34" or "1.5" is a single malformed
+   *  token rather than two numbers.
+   */
+  static auto is_separator(char c) -> bool {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f'
+        || c == ',';
+  }
+
+  void close(void) {
+    if (owns_fd_ && fd_ >= 0) { ::close(fd_); }
+    fd_ = -1;
+    owns_fd_ = false;
+  }
+
+  /*
+   *  Keep the unconsumed tail, then read as much as fits behind
+   *  it.  Returns false once the input is exhausted.
+   */
+  auto refill(void) -> bool {
+    std::memmove(buffer_.get(), buffer_.get() + pos_, len_ - pos_);
+    len_ -= pos_;
+    pos_ = 0;
+    if (len_ == chunk_size) {
+      throw std::length_error("avi::stream: token longer than chunk_size");
+    }
+
+    for (;;) {
+      auto const n = ::read(fd_, buffer_.get() + len_, chunk_size - len_);
+      if (n < 0) {
+        if (errno == EINTR) { continue; }
+        throw std::system_error(errno, std::generic_category(), "avi::stream: read");
+      }
+      if (n == 0) {
+        input_eof_ = true;
+        return false;
+      }
+      len_ += static_cast<std::size_t>(n);
+      return true;
+    }
+  }
+
+  void advance(void) {
+    auto * const buf = buffer_.get();
+    for (;;) {
+      while (pos_ < len_ && is_separator(buf[pos_])) { ++pos_; }
+      if (pos_ == len_) {
+        if (input_eof_ || !refill()) {
+          done_ = true;
+          return;
+        }
+        continue;
+      }
+
+      auto end = pos_;
+      while (end < len_ && !is_separator(buf[end])) { ++end; }
+      if (end == len_ && !input_eof_) {
+        refill();
+        continue;
+      }
+
+      auto const * first = buf + pos_;
+      if (*first == '+' && (end - pos_ == 1 || first[1] != '-')) { ++first; }
+      auto const [ptr, ec] = std::from_chars(first, buf + end, current_);
+      if (ec != std::errc() || ptr != buf + end) {
+        throw std::invalid_argument("avi::stream: malformed integer '"
+                                    + std::string(buf + pos_, buf + end) + "'");
+      }
+      pos_ = end;
+      return;
+    }
+  }
+
+  int fd_ = -1;
+  bool owns_fd_ = false;
+  std::unique_ptr<char[]> buffer_;
+  std::size_t pos_ = 0;
+  std::size_t len_ = 0;
+  bool input_eof_ = false;
+  bool done_ = false;
+  T current_ = T();
+};
+
+using int_stream = basic_int_stream<int>;
+
+} /* namespace stream */
+} /* namespace avi */
+
+#endif /* int_stream_h */
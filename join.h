@@ -0,0 +1,445 @@
+//
+//  join.h
+//  CF.STL_Ranges_00
+//
+//  Hash join of a pipeline against a second range.
+//
+
+#ifndef join_h
+#define join_h
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include "flat_table.h"
+#include "parallel_pipeline.h"
+
+namespace avi {
+namespace hash_join {
+
+namespace detail {
+
+//  MARK: - Configuration
+/*
+ *  A hashed side is partitioned once its table and rows would no
+ *  longer fit in half the L2 cache (the other half is left to the
+ *  rows streaming past it).
+ */
+inline
+auto l2_cache_bytes(void) -> std::size_t {
+  static auto const bytes = [] {
+#if defined(_SC_LEVEL2_CACHE_SIZE)
+    auto const reported = ::sysconf(_SC_LEVEL2_CACHE_SIZE);
+    if (reported > 0) { return static_cast<std::size_t>(reported); }
+#endif
+    return std::size_t { 1024 * 1024 };
+  }();
+  return bytes;
+}
+
+/*
+ *  Lookups are issued this many at a time: all of the batch's
+ *  table lines are prefetched before the first lookup, so the
+ *  misses overlap instead of being paid one after another.
+ */
+inline constexpr std::size_t probe_batch = 16;
+
+/*
+ *  Partition by the hash bits just below the table's 7-bit tag;
+ *  the table itself indexes by the low bits.
+ */
+inline constexpr std::size_t partition_shift = 57 - 12;
+inline constexpr std::size_t max_partition_bits = 12;
+
+//  MARK: - Hashed Side
+/*
+ *  The side that is looked up: its rows grouped by key in one
+ *  array, and a flat table from each key to its run of rows.
+ *  Runs are 32-bit offsets, which keeps table slots small.
+ */
+template <typename K, typename V>
+class hashed_side {
+public:
+  struct run {
+    std::uint32_t first = 0;
+    std::uint32_t count = 0;
+  };
+
+  template <typename I, typename KeyFn>
+  hashed_side(I first, I last, KeyFn & key) {
+    auto const n = static_cast<std::size_t>(last - first);
+    if (n > std::numeric_limits<std::uint32_t>::max()) {
+      throw std::length_error("avi::join: too many rows to hash");
+    }
+    table_.reserve(n);
+    for (auto it = first; it != last; ++it) {
+      ++table_[static_cast<K>(std::invoke(key, *it))].count;
+    }
+    auto running = std::uint32_t { 0 };
+    table_.for_each([&](K const &, run & r) {
+      r.first = running;
+      running += std::exchange(r.count, 0);
+    });
+    rows_.resize(n);
+    for (auto it = first; it != last; ++it) {
+      auto & r = table_[static_cast<K>(std::invoke(key, *it))];
+      rows_[r.first + r.count++] = *it;
+    }
+  }
+
+  void prefetch(std::uint64_t h) const { table_.prefetch_hash(h); }
+
+  /*
+   *  The rows whose key is key, as a (possibly empty) span.
+   */
+  auto rows(K const & key, std::uint64_t h) const -> std::span<V const> {
+    auto const * r = table_.find(key, h);
+    if (r == nullptr) { return {}; }
+    return std::span<V const>(rows_.data() + r->first, r->count);
+  }
+
+private:
+  flat::table<K, run> table_;
+  std::vector<V> rows_;
+};
+
+/*
+ *  Join [first, last) of the scanned side against a hashed side,
+ *  probe_batch elements at a time, appending emit(scanned, hashed)
+ *  for every match to out.
+ */
+template <typename K, typename V, typename I, typename KeyFn, typename Emit, typename Row>
+void probe(hashed_side<K, V> const & side, I first, I last, KeyFn & key,
+           Emit const & emit, std::vector<Row> & out) {
+  auto keys = std::array<K, probe_batch> {};
+  auto hashes = std::array<std::uint64_t, probe_batch> {};
+  while (first != last) {
+    auto const k = std::min<std::size_t>(probe_batch, static_cast<std::size_t>(last - first));
+    for (auto j = std::size_t { 0 }; j < k; ++j) {
+      keys[j] = static_cast<K>(std::invoke(key, first[static_cast<std::ptrdiff_t>(j)]));
+      hashes[j] = flat::hash_of(keys[j]);
+      side.prefetch(hashes[j]);
+    }
+    for (auto j = std::size_t { 0 }; j < k; ++j) {
+      for (auto const & match : side.rows(keys[j], hashes[j])) {
+        out.push_back(emit(first[static_cast<std::ptrdiff_t>(j)], match));
+      }
+    }
+    first += static_cast<std::ptrdiff_t>(k);
+  }
+}
+
+//  MARK: - Partitioning
+/*
+ *  Elements of a sized random-access range regrouped by hash
+ *  partition, in parallel chunks: a histogram per chunk, a prefix
+ *  sum over (partition, chunk), and a scatter that keeps each
+ *  partition in source order.  Partition p is [offsets[p],
+ *  offsets[p + 1]) of values.
+ */
+template <typename V>
+struct partitioned {
+  std::vector<V> values;
+  std::vector<std::size_t> offsets;
+};
+
+template <typename V, typename K, typename Src, typename KeyFn>
+auto partition(Src & src, KeyFn & key, std::size_t bits) -> partitioned<V> {
+  auto const parts = std::size_t { 1 } << bits;
+  auto const n = static_cast<std::size_t>(std::ranges::size(src));
+  auto const chunks = parallel::chunk_count(n);
+  auto const first = std::ranges::begin(src);
+  auto const lo = [&](std::size_t c) { return static_cast<std::ptrdiff_t>(n * c / chunks); };
+  auto const part_of = [&](KeyFn & local_key, auto const & v) {
+    auto const h = flat::hash_of(static_cast<K>(std::invoke(local_key, v)));
+    return static_cast<std::size_t>(h >> partition_shift) & (parts - 1);
+  };
+
+  auto hist = std::vector<std::vector<std::size_t>>(chunks, std::vector<std::size_t>(parts));
+  parallel::for_each_chunk(chunks, [&](std::size_t c) {
+    auto local_key = key;
+    auto & h = hist[c];
+    for (auto it = first + lo(c); it != first + lo(c + 1); ++it) {
+      ++h[part_of(local_key, *it)];
+    }
+  });
+
+  auto result = partitioned<V> {};
+  result.offsets.resize(parts + 1);
+  auto running = std::size_t { 0 };
+  for (auto p = std::size_t { 0 }; p < parts; ++p) {
+    result.offsets[p] = running;
+    for (auto c = std::size_t { 0 }; c < chunks; ++c) {
+      running += std::exchange(hist[c][p], running);
+    }
+  }
+  result.offsets[parts] = running;
+
+  result.values.resize(n);
+  parallel::for_each_chunk(chunks, [&](std::size_t c) {
+    auto local_key = key;
+    auto & cursor = hist[c];
+    for (auto it = first + lo(c); it != first + lo(c + 1); ++it) {
+      result.values[cursor[part_of(local_key, *it)]++] = *it;
+    }
+  });
+  return result;
+}
+
+/*
+ *  Concatenate per-chunk (or per-partition) outputs in order, each
+ *  moved to its place in parallel when rows can be default-
+ *  constructed first.
+ */
+template <typename Row>
+auto concat(std::vector<std::vector<Row>> & parts) -> std::vector<Row> {
+  if (parts.size() == 1) { return std::move(parts[0]); }
+  auto offsets = std::vector<std::size_t>(parts.size() + 1);
+  for (auto i = std::size_t { 0 }; i < parts.size(); ++i) {
+    offsets[i + 1] = offsets[i] + parts[i].size();
+  }
+
+  auto out = std::vector<Row>();
+  if constexpr (std::default_initializable<Row>) {
+    out.resize(offsets.back());
+    parallel::for_each_chunk(parts.size(), [&](std::size_t i) {
+      std::ranges::move(parts[i], out.begin() + static_cast<std::ptrdiff_t>(offsets[i]));
+      parts[i] = std::vector<Row>();
+    });
+  }
+  else {
+    out.reserve(offsets.back());
+    for (auto & p : parts) {
+      std::ranges::move(p, std::back_inserter(out));
+      p = std::vector<Row>();
+    }
+  }
+  return out;
+}
+
+//  MARK: - Driver
+/*
+ *  Join scanned against hashed, both sized random-access.  emit
+ *  puts each match into the caller's (probe, build) order.
+ *
+ *    hashed side fits in L2    one table, probed in parallel
+ *                              chunks of the scanned side, output
+ *                              in scanned order
+ *    hashed side larger        both sides partitioned by hash so
+ *                              every partition's table fits in L2,
+ *                              then partitions joined in parallel;
+ *                              output partition by partition
+ *    sequential                one table, probed in one pass on the
+ *                              calling thread, output in scanned
+ *                              order
+ */
+template <typename K, typename Row, typename Hashed, typename HashedKey,
+          typename Scanned, typename ScannedKey, typename Emit>
+auto run(Hashed & hashed, HashedKey & hashed_key,
+         Scanned & scanned, ScannedKey & scanned_key, Emit const & emit,
+         bool sequential) -> std::vector<Row> {
+  using hashed_value = std::ranges::range_value_t<Hashed>;
+  using scanned_value = std::ranges::range_value_t<Scanned>;
+  using side_type = hashed_side<K, hashed_value>;
+
+  auto const n_hashed = static_cast<std::size_t>(std::ranges::size(hashed));
+  auto const n_scanned = static_cast<std::size_t>(std::ranges::size(scanned));
+  auto const row_bytes = sizeof(hashed_value) + 2 * (sizeof(K) + sizeof(typename side_type::run) + 1);
+  auto const budget = l2_cache_bytes() / 2;
+
+  if (sequential) {
+    auto const side = side_type(std::ranges::begin(hashed), std::ranges::end(hashed), hashed_key);
+    auto out = std::vector<Row>();
+    out.reserve(n_scanned);
+    probe(side, std::ranges::begin(scanned), std::ranges::end(scanned), scanned_key, emit, out);
+    return out;
+  }
+
+  if (n_hashed * row_bytes <= budget) {
+    auto const side = side_type(std::ranges::begin(hashed), std::ranges::end(hashed), hashed_key);
+    auto const chunks = parallel::chunk_count(n_scanned);
+    auto outs = std::vector<std::vector<Row>>(chunks);
+    auto const first = std::ranges::begin(scanned);
+    parallel::for_each_chunk(chunks, [&](std::size_t c) {
+      // Most joins against a dimension table match each element
+      // at most once: room for that avoids regrowing the output
+      auto local_key = scanned_key;
+      auto out = std::vector<Row>();
+      out.reserve(n_scanned * (c + 1) / chunks - n_scanned * c / chunks);
+      probe(side, first + static_cast<std::ptrdiff_t>(n_scanned * c / chunks),
+            first + static_cast<std::ptrdiff_t>(n_scanned * (c + 1) / chunks),
+            local_key, emit, out);
+      outs[c] = std::move(out);
+    });
+    return concat(outs);
+  }
+
+  auto const wanted = std::bit_ceil((n_hashed * row_bytes + budget - 1) / budget);
+  auto const bits = std::min<std::size_t>(static_cast<std::size_t>(std::countr_zero(wanted)),
+                                          max_partition_bits);
+  auto const parts = std::size_t { 1 } << bits;
+  auto const h = partition<hashed_value, K>(hashed, hashed_key, bits);
+  auto const s = partition<scanned_value, K>(scanned, scanned_key, bits);
+
+  auto outs = std::vector<std::vector<Row>>(parts);
+  parallel::pool().parallel_for(0, parts, 1, [&](std::size_t lo, std::size_t hi) {
+    auto local_hashed_key = hashed_key;
+    auto local_scanned_key = scanned_key;
+    for (auto p = lo; p < hi; ++p) {
+      auto const side = side_type(h.values.begin() + static_cast<std::ptrdiff_t>(h.offsets[p]),
+                                  h.values.begin() + static_cast<std::ptrdiff_t>(h.offsets[p + 1]),
+                                  local_hashed_key);
+      auto out = std::vector<Row>();
+      out.reserve(s.offsets[p + 1] - s.offsets[p]);
+      probe(side, s.values.begin() + static_cast<std::ptrdiff_t>(s.offsets[p]),
+            s.values.begin() + static_cast<std::ptrdiff_t>(s.offsets[p + 1]),
+            local_scanned_key, emit, out);
+      outs[p] = std::move(out);
+    }
+  });
+  return concat(outs);
+}
+
+/*
+ *  A range the driver can split: sized random-access as it is, or
+ *  anything else copied into a vector first.
+ */
+template <typename R>
+auto splittable(R & rng) {
+  if constexpr (std::ranges::random_access_range<R> && std::ranges::sized_range<R>) {
+    return std::ranges::ref_view<R>(rng);
+  }
+  else {
+    auto copy = std::vector<std::ranges::range_value_t<R>>();
+    std::ranges::copy(rng, std::back_inserter(copy));
+    return copy;
+  }
+}
+
+} /* namespace detail */
+
+//  MARK: - Stage
+template <std::ranges::input_range Build, typename BuildKey, typename ProbeKey>
+  requires std::ranges::view<Build>
+struct join_closure {
+  // Iterating a view may update it (views::filter caches its
+  // begin), so the build side is usable from a const closure
+  mutable Build build;
+  BuildKey build_key;
+  ProbeKey probe_key;
+  bool sequential = false;
+
+  template <std::ranges::input_range R>
+  auto operator()(R && probe) const {
+    using probe_value = std::ranges::range_value_t<R>;
+    using build_value = std::ranges::range_value_t<Build>;
+    using key_type = std::common_type_t<
+      std::remove_cvref_t<std::invoke_result_t<ProbeKey const &, probe_value const &>>,
+      std::remove_cvref_t<std::invoke_result_t<BuildKey const &, build_value const &>>>;
+    using row_type = std::pair<probe_value, build_value>;
+
+    auto probe_side = std::views::all(std::forward<R>(probe));
+    auto b = detail::splittable(build);
+    auto p = detail::splittable(probe_side);
+    auto bk = build_key;
+    auto pk = probe_key;
+
+    // Hash whichever side is smaller
+    if (std::ranges::size(b) <= std::ranges::size(p)) {
+      return detail::run<key_type, row_type>(b, bk, p, pk,
+        [](probe_value const & pv, build_value const & bv) { return row_type { pv, bv }; },
+        sequential);
+    }
+    return detail::run<key_type, row_type>(p, pk, b, bk,
+      [](build_value const & bv, probe_value const & pv) { return row_type { pv, bv }; },
+      sequential);
+  }
+
+  template <std::ranges::input_range R>
+  friend auto operator|(R && probe, join_closure const & self) {
+    return self(std::forward<R>(probe));
+  }
+};
+
+} /* namespace hash_join */
+
+/*
+ *  join(build, key)
+ *  join(build, build_key, probe_key)
+ *
+ *  Inner equi-join of a pipeline (the probe side) against another
+ *  range (the build side), e.g. enriching ids with a dimension
+ *  table:
+ *
+ *    auto named = numbers
+ *         | views::filter(is_even)
+ *         | avi::join(names, [](auto const & row) { return row.id; },
+ *                     [](int n) { return n; });
+ *
+ *  gives a std::vector<std::pair<probe element, build element>>,
+ *  one pair per match.  The smaller side is put in an
+ *  avi::flat::table (each key mapped to its rows, stored together)
+ *  and the other side looked up against it, a batch of prefetched
+ *  keys at a time, in parallel chunks.  When the smaller side
+ *  would not fit in L2, both sides are first partitioned by hash
+ *  and the partitions joined in parallel, one cache-resident
+ *  table each.  Ranges that are not sized random-access are
+ *  copied into a vector first.
+ *
+ *  The order of the pairs is unspecified: it follows whichever
+ *  side is larger, or the partitions, and so depends on the
+ *  inputs' sizes and on the machine's L2 size.  Sort the result
+ *  when the order matters.  One table holds at most 2^32 - 1
+ *  rows; a side that would need more throws std::length_error.
+ *
+ *  In parallel the key functions, and any filter or transform
+ *  behind a random-access side, run on several threads at once:
+ *  they must be thread-safe and free of side effects.
+ *  join(seq, build, ...) joins on the calling thread alone.
+ */
+template <std::ranges::viewable_range Build, typename BuildKey, typename ProbeKey>
+  requires std::ranges::input_range<Build>
+auto join(Build && build, BuildKey build_key, ProbeKey probe_key) {
+  using view_type = std::views::all_t<Build>;
+  return hash_join::join_closure<view_type, BuildKey, ProbeKey> {
+    std::views::all(std::forward<Build>(build)), std::move(build_key), std::move(probe_key) };
+}
+
+template <std::ranges::viewable_range Build, typename KeyFn>
+  requires std::ranges::input_range<Build>
+auto join(Build && build, KeyFn key) {
+  return join(std::forward<Build>(build), key, key);
+}
+
+template <std::ranges::viewable_range Build, typename BuildKey, typename ProbeKey>
+  requires std::ranges::input_range<Build>
+auto join(parallel::sequenced_policy, Build && build, BuildKey build_key, ProbeKey probe_key) {
+  auto closure = join(std::forward<Build>(build), std::move(build_key), std::move(probe_key));
+  closure.sequential = true;
+  return closure;
+}
+
+template <std::ranges::viewable_range Build, typename KeyFn>
+  requires std::ranges::input_range<Build>
+auto join(parallel::sequenced_policy policy, Build && build, KeyFn key) {
+  return join(policy, std::forward<Build>(build), key, key);
+}
+
+} /* namespace avi */
+
+#endif /* join_h */
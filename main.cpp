@@ -28,11 +28,32 @@
 #include <iomanip>
 #include <ranges>
 #include <vector>
+#include <array>
+#include <span>
 #include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+#include <system_error>
 #include <version>
 
 #include "version_info.h"
 #include "identify.h"
+#include "fused_pipeline.h"
+#include "parallel_pipeline.h"
+#include "format_sink.h"
+#include "int_stream.h"
+#include "pipeline_stats.h"
+#include "compile_time.h"
+#include "materialize.h"
+#include "chunk_generator.h"
+#include "stage_pipeline.h"
+#include "radix_sort.h"
+#include "reduce.h"
+#include "group_by.h"
+#include "join.h"
+#include "top_k.h"
+#include "masked_update.h"
+#include "distinct.h"
 
 #define stfy(STR) #STR
 #define xstfy(STR) str(STR)
@@ -59,14 +80,16 @@ auto const tiddle = delimiter('~');
 } /* namespace konst */
 
 void use_for_each(void);
+auto use_stream(char const * source) -> bool;
+auto countdown(int from) -> avi::gen::chunk_generator<int>;
 
 [[maybe_unused]]
 auto show = [](auto & container) {
-  // Use lazy evaluation to print out the container
-  for (auto const & v : container) {
-    std::cout << std::setw(2) << v;
-  }
-  std::cout << std::endl;
+  // Use lazy evaluation to format the container into the shared
+  // sink, then emit the whole line with a single write(2)
+  auto & sink = avi::format::stdout_sink();
+  sink.print(container, 2);
+  sink.flush();
 };
 
 /*
@@ -97,13 +120,130 @@ int main(int argc, char const * argv[]) {
 
   // Process our dataset
   //  [looks suspiciously like a Hartmann (CMS/Batch) pipeline.]
+  //  [stage statistics are collected with -DAVI_PIPELINE_STATS;
+  //   stages are reported in the order their wrappers are made.]
+  auto counted_even = avi::stats::count_filter("filter(is_even)", is_even);
+  auto counted_inc = avi::stats::count_transform("transform(++n)", [](auto n) { return ++n; });
   auto results = numbers
-       | filter(is_even)
-       | transform([](auto n) { return ++n; })
+       | filter(counted_even)
+       | transform(counted_inc)
        | reverse;
 
   // Use lazy evaluation to print out the results
   show(results);  // Output: 3 5 7
+
+  // Same pipeline run as a single fused forward pass
+  auto fused = avi::fused::execute(results);
+  show(fused);  // Output: 3 5 7
+
+  // Same pipeline split into chunks across all cores
+  auto parallel = avi::parallel::filter_transform(numbers,
+                                                  is_even,
+                                                  [](auto n) { return ++n; },
+                                                  avi::parallel::order::reversed);
+  show(parallel);  // Output: 3 5 7
+
+  // Filter stage materialized in parallel, already reversed, then
+  // transformed lazily
+  auto compacted = std::vector<int>();
+  avi::parallel::filter_into(numbers, compacted, is_even, avi::parallel::order::reversed);
+  auto bumped = compacted | transform([](auto n) { return ++n; });
+  show(bumped);  // Output: 3 5 7
+
+  // Same stages, ordered by a sort action instead of reverse
+  auto sorted = numbers
+       | filter(is_even)
+       | transform([](auto n) { return ++n; })
+       | avi::sort();
+  show(sorted);  // Output: 3 5 7
+
+  // Same stages reduced to aggregates
+  auto const total = numbers
+       | filter(is_even)
+       | transform([](auto n) { return ++n; })
+       | avi::reduce::sum();
+  auto const kept = numbers | filter(is_even) | avi::reduce::count();
+  std::cout << "sum " << total << ", count " << kept << '\n';  // Output: sum 15, count 3
+
+  // Same stages grouped by parity, each group reduced
+  auto const groups = numbers
+       | transform([](auto n) { return ++n; })
+       | avi::group_by(is_even)
+       | avi::aggregate(avi::reduce::sum(), avi::reduce::count(), avi::reduce::max());
+  for (auto const & [even, sum, count, max] : groups) {
+    std::cout << (even ? "even" : "odd") << ": sum " << sum
+              << ", count " << count << ", max " << max << '\n';
+  }  // Output: odd: sum 15, count 3, max 7 / even: sum 12, count 3, max 6
+
+  // Filtered stage enriched from a lookup table by hash join
+  auto const names = std::vector<std::pair<int, char const *>> {
+    { 2, "two" }, { 4, "four" }, { 6, "six" }, { 8, "eight" },
+  };
+  auto named = numbers
+       | filter(is_even)
+       | avi::join(names, [](auto const & row) { return row.first; },
+                   [](int n) { return n; });
+  // The join leaves the order of its pairs unspecified
+  std::ranges::sort(named, std::ranges::less {}, [](auto const & pair) { return pair.first; });
+  for (auto const & [n, row] : named) {
+    std::cout << n << ' ' << row.second << ' ';
+  }
+  std::cout << '\n';  // Output: 2 two 4 four 6 six
+
+  // Same stages cut down to the two largest results
+  auto const best = numbers
+       | filter(is_even)
+       | transform([](auto n) { return ++n; })
+       | avi::top_k(2);
+  show(best);  // Output: 7 5
+
+  // Stream with repeats cut down to first sightings, lazily
+  auto const readings = std::vector { 3, 1, 3, 4, 1, 5, 4, 3 };
+  auto fresh = readings | avi::distinct();
+  show(fresh);  // Output: 3 1 4 5
+
+  // Same readings sorted: only neighbours are compared
+  auto sorted_readings = readings;
+  std::ranges::sort(sorted_readings);
+  auto runs = sorted_readings | avi::distinct(avi::dedup::sorted);
+  show(runs);  // Output: 1 3 4 5
+
+  // Same pipeline over literal data, evaluated by the compiler
+  static constexpr auto literal_numbers = std::array { 6, 5, 4, 3, 2, 1 };
+  constexpr auto baked = avi::ct::evaluate<literal_numbers>([](auto const & src) {
+    return src
+         | filter([](auto const n) { return n % 2 == 0; })
+         | transform([](auto n) { return ++n; })
+         | reverse;
+  });
+  static_assert(baked == std::array { 3, 5, 7 });
+  show(baked);  // Output: 3 5 7
+
+  // Same pipeline with the filtered stage materialised into a
+  // per-run arena; everything is released when the arena goes
+  auto arena = avi::run_arena<>();
+  auto evens = numbers | filter(is_even) | avi::materialize(arena);
+  auto staged = evens
+       | transform([](auto n) { return ++n; })
+       | reverse;
+  show(staged);  // Output: 3 5 7
+
+  // Same stages over data generated lazily a chunk at a time; a
+  // generator is single-pass, so it is shown in generated order
+  auto generated = countdown(6)
+       | filter(is_even)
+       | transform([](auto n) { return ++n; });
+  show(generated);  // Output: 7 5 3
+
+  // Same stages with the source, each stage and the output on
+  // threads of their own, handing batches through ring buffers
+  auto & out = avi::format::stdout_sink();
+  avi::parallel::pipelined(numbers | reverse,
+                           avi::batch::filter(is_even)
+                           | avi::batch::transform([](auto n) { return ++n; }),
+                           [&](int n) { out.put(n, 2); });
+  out.put_char('\n');
+  out.flush();  // Output: 3 5 7
 #else
 # warning "Missing C++ library feature  std::views"
   std::cout.put('\n');
@@ -115,6 +255,12 @@ int main(int argc, char const * argv[]) {
 
   use_for_each();
 
+  // Optionally run the pipeline over a stream: a file name, or "-"
+  // for standard input
+  if (argc > 1 && !use_stream(argv[1])) {
+    return EXIT_FAILURE;
+  }
+
   return 0;
 }
 
@@ -126,18 +272,14 @@ int main(int argc, char const * argv[]) {
 void use_for_each(void) {
   std::cout << "In fnuction " << __func__ << "()\n";
 
-  namespace ranges = std::ranges;
-
   std::vector<int> vec = { 1, 2, 3, 4, 5, };
   show(vec);
 
-  [[maybe_unused]]
-  const auto even = [](int i) { return 0 == i % 2; };
-
 #ifdef __cpp_lib_ranges
-  ranges::for_each(vec
-                   | std::views::filter(even),
-                   [](int & i) { i += 1; });
+  // ranges::for_each(vec | views::filter(even), [](int & i) { i += 1; })
+  // as a masked add: split across workers, and vectorized for a
+  // predicate with a lane mask
+  avi::parallel::masked_add(vec, avi::simd::is_even {}, 1);
 #else
 # warning "Missing C++ library feature std::ranges::for_each"
   std::cout.put('\n');
@@ -151,3 +293,61 @@ void use_for_each(void) {
 
   return;
 }
+
+/*
+ *  MARK:  use_stream()
+ *
+ *  Run filter | transform over integers read from source in
+ *  fixed-size chunks, so memory use stays constant however large
+ *  the input is.  A source that cannot be opened or read, or that
+ *  holds something other than integers, is reported on stderr and
+ *  false returned.
+ */
+auto use_stream(char const * source) -> bool {
+  std::cout << "In fnuction " << __func__ << "(" << source << ")\n";
+
+#ifdef __cpp_lib_ranges
+  [[maybe_unused]]
+  auto is_even = [](auto const n) { return n % 2 == 0; };
+
+  // Keep whatever was printed before the error
+  auto const fail = [](std::exception const & e) {
+    avi::format::stdout_sink().flush();
+    std::cout << std::endl;
+    std::cerr << "use_stream: " << e.what() << std::endl;
+    return false;
+  };
+
+  try {
+    // The stream is a move-only view, so it is handed to the pipeline
+    auto results = avi::stream::int_stream::open(source)
+         | std::views::filter(is_even)
+         | std::views::transform([](auto n) { return ++n; });
+
+    show(results);
+  }
+  catch (std::system_error const & e)     { return fail(e); }
+  catch (std::invalid_argument const & e) { return fail(e); }
+  catch (std::length_error const & e)     { return fail(e); }
+#else
+# warning "Missing C++ library feature  std::views"
+  std::cout << "std::views not available to C++ Ver "s << __cplusplus << '\n';
+#endif  /* __cpp_lib_ranges */
+
+  return true;
+}
+
+/*
+ *  MARK:  countdown()
+ *
+ *  Generate from, from - 1, ..., 1 into a fixed buffer and hand
+ *  each filled buffer to the pipeline with a single co_yield.
+ */
+auto countdown(int from) -> avi::gen::chunk_generator<int> {
+  auto buffer = std::array<int, 1024> {};
+  while (from > 0) {
+    auto k = std::size_t { 0 };
+    for (; k < buffer.size() && from > 0; ++k) { buffer[k] = from--; }
+    co_yield std::span(buffer).first(k);
+  }
+}
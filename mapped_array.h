@@ -0,0 +1,177 @@
+//
+//  mapped_array.h
+//  CF.STL_Ranges_00
+//
+//  Read-only memory-mapped array of raw little-endian integers.
+//
+
+#ifndef mapped_array_h
+#define mapped_array_h
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace avi {
+namespace mapped {
+
+//  MARK: - Access Hints
+enum class advice {
+  normal,
+  sequential,
+  random,
+  willneed,
+  dontneed,
+};
+
+namespace detail {
+
+inline
+auto to_madvise(advice a) -> int {
+  switch (a) {
+    case advice::sequential: return MADV_SEQUENTIAL;
+    case advice::random:     return MADV_RANDOM;
+    case advice::willneed:   return MADV_WILLNEED;
+    case advice::dontneed:   return MADV_DONTNEED;
+    case advice::normal:     break;
+  }
+  return MADV_NORMAL;
+}
+
+} /* namespace detail */
+
+//  MARK: - Mapped Array
+/*
+ *  mapped_array
+ *
+ *  Maps a file of raw T values read-only and exposes it as a
+ *  contiguous range, so
+ *
+ *    mapped | views::filter(is_even) | views::transform(...)
+ *
+ *  reads straight out of the page cache with no copy and no
+ *  parsing.  Pages are faulted in on demand, so files larger than
+ *  RAM work; advise() tells the kernel how the pages will be used.
+ *
+ *  The file is assumed to be in host byte order, which must be
+ *  little-endian.  Like a container, the object owns the mapping;
+ *  pipelines refer to it through views::all (a ref_view).
+ */
+template <typename T = std::int32_t>
+class mapped_array {
+  static_assert(std::is_trivially_copyable_v<T>);
+  static_assert(std::endian::native == std::endian::little,
+                "mapped_array reads little-endian data in place");
+
+public:
+  using value_type = T;
+  using size_type = std::size_t;
+  using const_iterator = T const *;
+
+  mapped_array(void) = default;
+
+  explicit mapped_array(std::string const & path, advice hint = advice::sequential) {
+    auto const fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      throw std::system_error(errno, std::generic_category(), path);
+    }
+
+    struct stat st {};
+    if (::fstat(fd, &st) != 0) {
+      auto const err = errno;
+      ::close(fd);
+      throw std::system_error(err, std::generic_category(), path);
+    }
+
+    auto const bytes = static_cast<std::size_t>(st.st_size);
+    if (bytes % sizeof(T) != 0) {
+      ::close(fd);
+      throw std::invalid_argument(path + ": size is not a multiple of the element size");
+    }
+
+    if (bytes != 0) {
+      auto * const p = ::mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE | MAP_NORESERVE, fd, 0);
+      if (p == MAP_FAILED) {
+        auto const err = errno;
+        ::close(fd);
+        throw std::system_error(err, std::generic_category(), path);
+      }
+      data_ = static_cast<T const *>(p);
+      size_ = bytes / sizeof(T);
+    }
+    ::close(fd);
+
+    advise(hint);
+  }
+
+  mapped_array(mapped_array && other) noexcept
+    : data_(std::exchange(other.data_, nullptr)),
+      size_(std::exchange(other.size_, 0)) {}
+
+  auto operator=(mapped_array && other) noexcept -> mapped_array & {
+    if (this != &other) {
+      unmap();
+      data_ = std::exchange(other.data_, nullptr);
+      size_ = std::exchange(other.size_, 0);
+    }
+    return *this;
+  }
+
+  mapped_array(mapped_array const &) = delete;
+  auto operator=(mapped_array const &) -> mapped_array & = delete;
+
+  ~mapped_array() { unmap(); }
+
+  /*
+   *  Apply a hint to the whole mapping, or to the elements
+   *  [first, first + count).  Hints are advisory; failures are
+   *  ignored.
+   */
+  void advise(advice hint, std::size_t first = 0, std::size_t count = SIZE_MAX) const {
+    if (data_ == nullptr || first >= size_) { return; }
+    count = std::min(count, size_ - first);
+
+    auto const page = static_cast<std::uintptr_t>(::sysconf(_SC_PAGESIZE));
+    auto const lo = reinterpret_cast<std::uintptr_t>(data_ + first) & ~(page - 1);
+    auto const hi = reinterpret_cast<std::uintptr_t>(data_ + first + count);
+    ::madvise(reinterpret_cast<void *>(lo), hi - lo, detail::to_madvise(hint));
+    return;
+  }
+
+  auto begin(void) const -> T const * { return data_; }
+  auto end(void)   const -> T const * { return data_ + size_; }
+  auto data(void)  const -> T const * { return data_; }
+  auto size(void)  const -> std::size_t { return size_; }
+  auto empty(void) const -> bool { return size_ == 0; }
+
+  auto operator[](std::size_t ix) const -> T const & { return data_[ix]; }
+
+private:
+  void unmap(void) {
+    if (data_ != nullptr) {
+      ::munmap(const_cast<T *>(data_), size_ * sizeof(T));
+    }
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+  T const * data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+} /* namespace mapped */
+} /* namespace avi */
+
+#endif /* mapped_array_h */
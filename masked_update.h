@@ -0,0 +1,154 @@
+//
+//  masked_update.h
+//  CF.STL_Ranges_00
+//
+//  Parallel in-place update of the elements that satisfy a
+//  predicate:
+//
+//    ranges::for_each(vec | views::filter(pred), [](int & i) { i += k; });
+//
+
+#ifndef masked_update_h
+#define masked_update_h
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ranges>
+#include <type_traits>
+
+#include "simd_filter.h"
+#include "parallel_pipeline.h"
+
+namespace avi {
+namespace parallel {
+
+namespace detail {
+
+//  MARK: - Serial Kernels
+/*
+ *  x = pred(x) ? fn(x) : x.  fn is only called for selected
+ *  elements, as under views::filter, so it may divide by, throw on
+ *  or otherwise depend on what pred rules out; every element is
+ *  stored, so when fn is simple the compiler can still if-convert
+ *  it into a select.
+ */
+template <typename T, typename Pred, typename Fn>
+inline
+void masked_update_serial(T * p, std::size_t n, Pred const & pred, Fn const & fn) {
+  for (auto i = std::size_t { 0 }; i < n; ++i) {
+    auto const x = p[i];
+    p[i] = std::invoke(pred, x) ? static_cast<T>(std::invoke(fn, x)) : x;
+  }
+  return;
+}
+
+/*
+ *  x += pred(x) ? k : 0.  Predicates with a vector form (see
+ *  simd_filter.h) run as compare / and / add (AVX2) or a masked
+ *  add (AVX-512); others, and the tail, add pred(x) ? k : 0, which
+ *  never adds to an element that is not selected.
+ */
+template <typename Pred>
+inline
+void masked_add_serial(int * p, std::size_t n, Pred const & pred, int k) {
+  auto i = std::size_t { 0 };
+
+#if defined(__AVX512F__)
+  if constexpr (requires (__m512i v) { { pred.mask(v) } -> std::same_as<__mmask16>; }) {
+    auto const kv = _mm512_set1_epi32(k);
+    for (; i + 16 <= n; i += 16) {
+      auto const v = _mm512_loadu_si512(p + i);
+      _mm512_storeu_si512(p + i, _mm512_mask_add_epi32(v, pred.mask(v), v, kv));
+    }
+  }
+#elif defined(__AVX2__)
+  if constexpr (requires (__m256i v) { pred.mask(v); }) {
+    auto const kv = _mm256_set1_epi32(k);
+    for (; i + 8 <= n; i += 8) {
+      auto * const at = reinterpret_cast<__m256i *>(p + i);
+      auto const v = _mm256_loadu_si256(at);
+      _mm256_storeu_si256(at, _mm256_add_epi32(v, _mm256_and_si256(pred.mask(v), kv)));
+    }
+  }
+#endif
+
+  for (; i < n; ++i) {
+    p[i] += std::invoke(pred, p[i]) ? k : 0;
+  }
+  return;
+}
+
+//  MARK: - Cache-Line Partitioning
+/*
+ *  Run body(first, count) over [p, p + n) in chunks whose inner
+ *  boundaries fall on cache-line boundaries.
+ */
+template <typename T, typename Body>
+void for_each_aligned_chunk(T * p, std::size_t n, Body && body) {
+  auto const chunks = chunk_count(n);
+  auto const base = reinterpret_cast<std::uintptr_t>(p);
+  auto const boundary = [&](std::size_t c) -> std::size_t {
+    if (c == 0) { return 0; }
+    if (c == chunks) { return n; }
+    auto const addr = base + (n * c / chunks) * sizeof(T);
+    auto const up = (addr + cache_line - 1) & ~std::uintptr_t { cache_line - 1 };
+    return std::min(n, static_cast<std::size_t>((up - base) / sizeof(T)));
+  };
+
+  for_each_chunk(chunks, [&](std::size_t c) {
+    auto const lo = boundary(c);
+    auto const hi = boundary(c + 1);
+    if (lo < hi) { body(p + lo, hi - lo); }
+  });
+  return;
+}
+
+} /* namespace detail */
+
+//  MARK: - Masked Update
+/*
+ *  masked_update()
+ *
+ *  In place, for every element x of rng: x = pred(x) ? fn(x) : x.
+ *  Same result as ranges::for_each over views::filter(pred), for
+ *  any input size (fn is never called on an element pred rejects),
+ *  but split across workers on cache-line-aligned chunks.  pred
+ *  and fn run concurrently, so they must be safe to call from
+ *  several threads at once.
+ */
+template <std::ranges::contiguous_range R, typename Pred, typename Fn>
+  requires std::ranges::sized_range<R>
+        && std::is_arithmetic_v<std::ranges::range_value_t<R>>
+void masked_update(R && rng, Pred pred, Fn fn) {
+  auto * const p = std::ranges::data(rng);
+  auto const n = static_cast<std::size_t>(std::ranges::size(rng));
+  detail::for_each_aligned_chunk(p, n, [&](auto * first, std::size_t count) {
+    detail::masked_update_serial(first, count, pred, fn);
+  });
+  return;
+}
+
+/*
+ *  masked_add()
+ *
+ *  masked_update() specialised to x += k, the operation in
+ *  use_for_each(); this is the form with explicit SIMD kernels.
+ */
+template <std::ranges::contiguous_range R, typename Pred>
+  requires std::ranges::sized_range<R>
+        && std::same_as<std::ranges::range_value_t<R>, int>
+void masked_add(R && rng, Pred pred, int k) {
+  auto * const p = std::ranges::data(rng);
+  auto const n = static_cast<std::size_t>(std::ranges::size(rng));
+  detail::for_each_aligned_chunk(p, n, [&](int * first, std::size_t count) {
+    detail::masked_add_serial(first, count, pred, k);
+  });
+  return;
+}
+
+} /* namespace parallel */
+} /* namespace avi */
+
+#endif /* masked_update_h */
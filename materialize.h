@@ -0,0 +1,149 @@
+//
+//  materialize.h
+//  CF.STL_Ranges_00
+//
+//  Materialise pipeline stages into std::pmr vectors backed by a
+//  per-run arena.
+//
+
+#ifndef materialize_h
+#define materialize_h
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <ranges>
+#include <utility>
+#include <vector>
+
+namespace avi {
+
+//  MARK: - Terminal
+/*
+ *  materialize(mr)
+ *
+ *  Pipe terminal that copies a range into a std::pmr::vector whose
+ *  storage comes from mr:
+ *
+ *    auto evens = numbers | views::filter(is_even) | avi::materialize(arena);
+ *
+ *  Sized ranges are reserved up front, so the vector allocates
+ *  once.  With no resource the default pmr resource is used.
+ *  to_vector(mr) is the same terminal under the range-v3 name.
+ */
+struct materialize_closure {
+  std::pmr::memory_resource * resource;
+
+  template <std::ranges::input_range R>
+  auto operator()(R && rng) const {
+    using value_type = std::ranges::range_value_t<R>;
+    auto out = std::pmr::vector<value_type>(resource);
+    if constexpr (std::ranges::sized_range<R>) {
+      out.reserve(static_cast<std::size_t>(std::ranges::size(rng)));
+    }
+    for (auto && v : rng) {
+      out.push_back(std::forward<decltype(v)>(v));
+    }
+    return out;
+  }
+
+  template <std::ranges::input_range R>
+  friend auto operator|(R && rng, materialize_closure const & self) {
+    return self(std::forward<R>(rng));
+  }
+};
+
+inline
+auto materialize(std::pmr::memory_resource * mr = std::pmr::get_default_resource())
+    -> materialize_closure {
+  return materialize_closure { mr };
+}
+
+inline
+auto materialize(std::pmr::memory_resource & mr) -> materialize_closure {
+  return materialize_closure { &mr };
+}
+
+inline
+auto to_vector(std::pmr::memory_resource * mr = std::pmr::get_default_resource())
+    -> materialize_closure {
+  return materialize(mr);
+}
+
+inline
+auto to_vector(std::pmr::memory_resource & mr) -> materialize_closure {
+  return materialize(mr);
+}
+
+//  MARK: - Per-Run Arena
+/*
+ *  run_arena
+ *
+ *  Monotonic arena for one pipeline run.  Intermediate vectors
+ *  materialised into it bump-allocate from an inline buffer
+ *  (spilling to upstream blocks when it fills), never free
+ *  individually, and are all released at once by release() or
+ *  the destructor, in O(number of spilled blocks).
+ *
+ *  Vectors allocated from the arena must not outlive it.  A
+ *  long-lived arena can be reused for run after run:
+ *
+ *    auto arena = avi::run_arena<64 * 1024>();
+ *    for (auto & job : jobs) {
+ *      auto evens = job | views::filter(is_even) | avi::materialize(arena);
+ *      ...
+ *      arena.release();
+ *    }
+ */
+template <std::size_t InlineBytes = 16 * 1024>
+class run_arena : public std::pmr::memory_resource {
+public:
+  explicit run_arena(std::pmr::memory_resource * upstream = std::pmr::get_default_resource())
+    : overflow_(upstream) {}
+
+  run_arena(run_arena const &) = delete;
+  auto operator=(run_arena const &) -> run_arena & = delete;
+
+  /*
+   *  Drop every allocation made since construction or the last
+   *  release() and rewind to the inline buffer.
+   */
+  void release(void) {
+    used_ = 0;
+    overflow_.release();
+  }
+
+  auto resource(void) -> std::pmr::memory_resource * { return this; }
+
+private:
+  /*
+   *  Bump the cursor through the inline buffer; once it is full,
+   *  hand over to a monotonic resource on upstream, which grows
+   *  geometrically.
+   */
+  auto do_allocate(std::size_t bytes, std::size_t align) -> void * override {
+    auto const base = reinterpret_cast<std::uintptr_t>(buffer_.data());
+    auto const start = (base + used_ + align - 1) & ~(std::uintptr_t { align } - 1);
+    auto const offset = static_cast<std::size_t>(start - base);
+    if (offset <= InlineBytes && bytes <= InlineBytes - offset) {
+      used_ = offset + bytes;
+      return buffer_.data() + offset;
+    }
+    return overflow_.allocate(bytes, align);
+  }
+
+  void do_deallocate(void *, std::size_t, std::size_t) override {}
+
+  auto do_is_equal(std::pmr::memory_resource const & other) const noexcept -> bool override {
+    return this == &other;
+  }
+
+  alignas(std::max_align_t) std::array<std::byte, InlineBytes> buffer_;
+  std::size_t used_ = 0;
+  std::pmr::monotonic_buffer_resource overflow_;
+};
+
+} /* namespace avi */
+
+#endif /* materialize_h */
@@ -0,0 +1,102 @@
+//
+//  movable_box.h
+//  CF.STL_Ranges_00
+//
+//  Wrappers for callables and caches stored in views.
+//
+
+#ifndef movable_box_h
+#define movable_box_h
+
+#include <concepts>
+#include <memory>
+#include <optional>
+#include <utility>
+
+namespace avi {
+namespace detail {
+
+/*
+ *  movable_box
+ *
+ *  Views must be movable, but lambdas with captures are not
+ *  assignable.  Like the standard library's exposition-only
+ *  movable-box, this wraps a copy-constructible callable in an
+ *  optional and implements assignment as destroy + construct.
+ */
+template <std::copy_constructible T>
+class movable_box {
+public:
+  movable_box(void) requires std::default_initializable<T> : value_(std::in_place) {}
+  explicit movable_box(T value) : value_(std::in_place, std::move(value)) {}
+
+  movable_box(movable_box const &) = default;
+  movable_box(movable_box &&) = default;
+
+  auto operator=(movable_box const & other) -> movable_box & {
+    if (this != &other) {
+      if (other.value_) { value_.emplace(*other.value_); } else { value_.reset(); }
+    }
+    return *this;
+  }
+
+  auto operator=(movable_box && other) noexcept(std::is_nothrow_move_constructible_v<T>)
+      -> movable_box & {
+    if (this != &other) {
+      if (other.value_) { value_.emplace(std::move(*other.value_)); } else { value_.reset(); }
+    }
+    return *this;
+  }
+
+  auto operator*(void)       -> T &       { return *value_; }
+  auto operator*(void) const -> T const & { return *value_; }
+
+private:
+  std::optional<T> value_;
+};
+
+/*
+ *  non_propagating_cache
+ *
+ *  Like the standard library's exposition-only cache of the same
+ *  name: an optional that copies and moves as empty, so a view can
+ *  memoise begin() (or a larger result) and still be copied in
+ *  constant time.  Assigning to it, or moving from it, empties it.
+ */
+template <typename T>
+class non_propagating_cache {
+public:
+  non_propagating_cache(void) = default;
+
+  non_propagating_cache(non_propagating_cache const &) noexcept {}
+  non_propagating_cache(non_propagating_cache && other) noexcept { other.value_.reset(); }
+
+  auto operator=(non_propagating_cache const & other) noexcept -> non_propagating_cache & {
+    if (this != &other) { value_.reset(); }
+    return *this;
+  }
+
+  auto operator=(non_propagating_cache && other) noexcept -> non_propagating_cache & {
+    value_.reset();
+    other.value_.reset();
+    return *this;
+  }
+
+  auto has_value(void) const -> bool { return value_.has_value(); }
+
+  auto operator*(void)       -> T &       { return *value_; }
+  auto operator*(void) const -> T const & { return *value_; }
+
+  template <typename... Args>
+  auto emplace(Args &&... args) -> T & { return value_.emplace(std::forward<Args>(args)...); }
+
+  void reset(void) { value_.reset(); }
+
+private:
+  std::optional<T> value_;
+};
+
+} /* namespace detail */
+} /* namespace avi */
+
+#endif /* movable_box_h */
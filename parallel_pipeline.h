@@ -0,0 +1,225 @@
+//
+//  parallel_pipeline.h
+//  CF.STL_Ranges_00
+//
+//  Data-parallel, order-preserving execution of filter | transform
+//  [| reverse] over a random-access source.
+//
+
+#ifndef parallel_pipeline_h
+#define parallel_pipeline_h
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "thread_pool.h"
+
+namespace avi {
+namespace parallel {
+
+//  MARK: - Configuration
+enum class order {
+  forward,
+  reversed,
+};
+
+/*
+ *  The terminals that split their input across the pool (the
+ *  reduce terminals, top_k, group_by, join) call the caller's
+ *  predicates, transforms and key functions from several threads
+ *  at once, so those must be thread-safe and free of side effects.
+ *  Given seq as their first argument they run in one pass on the
+ *  calling thread instead:
+ *
+ *    numbers | views::filter(counting_pred) | avi::reduce::sum(avi::parallel::seq)
+ */
+struct sequenced_policy {
+  explicit sequenced_policy(void) = default;
+};
+
+inline constexpr sequenced_policy seq {};
+
+/*
+ *  Inputs smaller than this are not worth waking a second thread.
+ */
+inline constexpr std::size_t min_chunk = 16 * 1024;
+
+//  MARK: - Chunk Scheduling
+/*
+ *  for_each_chunk()
+ *
+ *  Call body(chunk) for every chunk in [0, chunks) on the shared
+ *  work-stealing pool.  The calling thread takes part as a
+ *  worker, and a slow chunk does not hold up the others: idle
+ *  workers steal what is left.
+ */
+template <typename Body>
+void for_each_chunk(std::size_t chunks, Body && body) {
+  pool().parallel_for(0, chunks, 1, [&](std::size_t lo, std::size_t hi) {
+    for (auto c = lo; c < hi; ++c) { body(c); }
+  });
+  return;
+}
+
+/*
+ *  Split n elements into chunks of at least min_chunk, with a few
+ *  chunks per worker so that skewed chunks can be balanced.
+ */
+inline
+auto chunk_count(std::size_t n) -> std::size_t {
+  if (n < 2 * min_chunk) { return 1; }
+  auto const wanted = worker_count() * 4;
+  return std::max<std::size_t>(1, std::min(wanted, n / min_chunk));
+}
+
+//  MARK: - Filter | Transform
+/*
+ *  filter_transform()
+ *
+ *  Equivalent to
+ *
+ *    src | views::filter(pred) | views::transform(fn) [| views::reverse]
+ *
+ *  materialized into a vector.  Each chunk of src is filtered and
+ *  transformed into its own buffer; a prefix sum over the chunk
+ *  sizes then gives each chunk its slice of the output, which is
+ *  filled in parallel.  For order::reversed the slices are taken
+ *  from the end and each chunk is copied backwards, so the result
+ *  matches the sequential pipeline element for element.
+ */
+template <std::ranges::random_access_range R, typename Pred, typename Fn>
+  requires std::ranges::sized_range<R>
+auto filter_transform(R && src, Pred pred, Fn fn, order ord = order::forward) {
+  using in_type = std::ranges::range_reference_t<R>;
+  using value_type = std::remove_cvref_t<std::invoke_result_t<Fn &, in_type>>;
+
+  auto const n = static_cast<std::size_t>(std::ranges::size(src));
+  auto const chunks = chunk_count(n);
+  auto const first = std::ranges::begin(src);
+
+  auto partial = std::vector<std::vector<value_type>>(chunks);
+  for_each_chunk(chunks, [&](std::size_t c) {
+    auto const lo = n * c / chunks;
+    auto const hi = n * (c + 1) / chunks;
+    auto & out = partial[c];
+    for (auto it = first + static_cast<std::ptrdiff_t>(lo);
+         it != first + static_cast<std::ptrdiff_t>(hi);
+         ++it) {
+      if (std::invoke(pred, *it)) {
+        out.push_back(std::invoke(fn, *it));
+      }
+    }
+  });
+
+  auto offsets = std::vector<std::size_t>(chunks + 1, 0);
+  for (auto c = std::size_t { 0 }; c < chunks; ++c) {
+    offsets[c + 1] = offsets[c] + partial[c].size();
+  }
+  auto const total = offsets[chunks];
+
+  auto results = std::vector<value_type>(total);
+  for_each_chunk(chunks, [&](std::size_t c) {
+    auto & part = partial[c];
+    if (ord == order::forward) {
+      std::ranges::move(part, results.begin()
+                              + static_cast<std::ptrdiff_t>(offsets[c]));
+    }
+    else {
+      std::ranges::move(part | std::views::reverse,
+                        results.begin()
+                        + static_cast<std::ptrdiff_t>(total - offsets[c + 1]));
+    }
+    std::vector<value_type>().swap(part);
+  });
+
+  return results;
+}
+
+//  MARK: - Filter Into
+/*
+ *  filter_into()
+ *
+ *  out = the elements of src that satisfy pred, in order (or, for
+ *  order::reversed, in reverse order), i.e. src | views::filter(pred)
+ *  [| views::reverse] materialized.  out is resized to fit and can
+ *  be reused from call to call.
+ *
+ *  Two passes over each chunk: the first only counts matches, a
+ *  prefix sum over the counts gives every chunk the exact slice of
+ *  out it owns, and the second copies the matches straight into
+ *  that slice.  No thread writes outside its slice, so there is
+ *  no locking and no per-chunk buffer.  For order::reversed the
+ *  slices are handed out from the end of out and filled backwards,
+ *  which costs nothing extra.  pred is called twice per element,
+ *  concurrently across chunks, so it must be thread-safe and give
+ *  the same answer both times; if it does not, the contents of out
+ *  are unspecified (every access stays within src and out).
+ */
+template <std::ranges::random_access_range R, typename T, typename Pred>
+  requires std::ranges::sized_range<R>
+        && std::convertible_to<std::ranges::range_reference_t<R>, T>
+void filter_into(R && src, std::vector<T> & out, Pred pred, order ord = order::forward) {
+  auto const n = static_cast<std::size_t>(std::ranges::size(src));
+  auto const chunks = chunk_count(n);
+  auto const first = std::ranges::begin(src);
+  auto const at = [&](std::size_t i) -> decltype(auto) {
+    return first[static_cast<std::ptrdiff_t>(i)];
+  };
+
+  auto offsets = std::vector<std::size_t>(chunks + 1, 0);
+  for_each_chunk(chunks, [&](std::size_t c) {
+    auto const lo = n * c / chunks;
+    auto const hi = n * (c + 1) / chunks;
+    auto count = std::size_t { 0 };
+    for (auto i = lo; i < hi; ++i) {
+      count += static_cast<bool>(std::invoke(pred, at(i)));
+    }
+    offsets[c + 1] = count;
+  });
+  for (auto c = std::size_t { 0 }; c < chunks; ++c) {
+    offsets[c + 1] += offsets[c];
+  }
+  auto const total = offsets[chunks];
+
+  out.resize(total);
+  auto * const dst = out.data();
+  for_each_chunk(chunks, [&](std::size_t c) {
+    auto i = n * c / chunks;
+    auto const hi = n * (c + 1) / chunks;
+    // Branch-free store-and-advance; stopping once the slice is
+    // full keeps the unconditional store inside it, and stopping at
+    // hi keeps a pred that now selects fewer elements inside src
+    if (ord == order::forward) {
+      auto * p = dst + offsets[c];
+      auto * const last = dst + offsets[c + 1];
+      for (; p != last && i < hi; ++i) {
+        auto && v = at(i);
+        *p = v;
+        p += static_cast<bool>(std::invoke(pred, v));
+      }
+    }
+    else {
+      auto k = total - offsets[c];
+      auto const last = total - offsets[c + 1];
+      for (; k != last && i < hi; ++i) {
+        auto && v = at(i);
+        dst[k - 1] = v;
+        k -= static_cast<bool>(std::invoke(pred, v));
+      }
+    }
+  });
+
+  return;
+}
+
+} /* namespace parallel */
+} /* namespace avi */
+
+#endif /* parallel_pipeline_h */
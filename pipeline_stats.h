@@ -0,0 +1,279 @@
+//
+//  pipeline_stats.h
+//  CF.STL_Ranges_00
+//
+//  Per-stage counters and timings for ranges pipelines.
+//
+//  Build with -DAVI_PIPELINE_STATS (make main-stats) to enable.
+//  Otherwise every wrapper hands back what it was given and the
+//  probe is views::all, so instrumented pipelines compile to the
+//  same code as plain ones.
+//
+
+#ifndef pipeline_stats_h
+#define pipeline_stats_h
+
+#include <ranges>
+#include <utility>
+
+#ifdef AVI_PIPELINE_STATS
+#   include <algorithm>
+#   include <atomic>
+#   include <chrono>
+#   include <cstdint>
+#   include <cstdio>
+#   include <cstdlib>
+#   include <deque>
+#   include <functional>
+#   include <iostream>
+#   include <mutex>
+#   include <string>
+#   include <type_traits>
+#   include <vector>
+#endif  /* AVI_PIPELINE_STATS */
+
+namespace avi {
+namespace stats {
+
+#ifdef AVI_PIPELINE_STATS
+//  MARK: - Stage Records
+/*
+ *  One record per instrumented stage.  Counters are updated with
+ *  relaxed atomics so the parallel executors can share a stage.
+ */
+struct stage {
+  stage(std::string n, std::uint64_t seq) : name(std::move(n)), sequence(seq) {}
+
+  std::string name;
+  std::uint64_t sequence;               // order of registration
+  std::atomic<std::uint64_t> elements_in { 0 };
+  std::atomic<std::uint64_t> elements_out { 0 };
+  std::atomic<std::uint64_t> pred_calls { 0 };
+  std::atomic<std::uint64_t> fn_calls { 0 };
+  std::atomic<std::uint64_t> nanoseconds { 0 };
+  std::atomic<std::uint64_t> bytes { 0 };
+};
+
+/*
+ *  report()
+ *
+ *  Print one line per stage, in the order the stages were
+ *  registered (created): elements in/out,
+ *  selectivity, predicate and transform calls, and time spent
+ *  inside the stage's callable.
+ */
+inline
+void report(std::ostream & os = std::cout);
+
+namespace detail {
+
+class registry {
+public:
+  static auto instance(void) -> registry & {
+    static auto * const reg = [] {
+      auto * r = new registry();
+      std::atexit([] { report(); });
+      return r;
+    }();
+    return *reg;
+  }
+
+  auto add(std::string name) -> stage * {
+    auto const lock = std::scoped_lock(mutex_);
+    return &stages_.emplace_back(std::move(name), stages_.size());
+  }
+
+  /*
+   *  fn(stage) for every stage, in order of registration.  Within
+   *  one expression the operands of a | may be evaluated in either
+   *  order, so wrappers that must be reported in pipeline order
+   *  are best created in separate statements.
+   */
+  template <typename Fn>
+  void visit(Fn && fn) {
+    auto const lock = std::scoped_lock(mutex_);
+    auto sorted = std::vector<stage *>();
+    sorted.reserve(stages_.size());
+    for (auto & s : stages_) { sorted.push_back(&s); }
+    std::ranges::sort(sorted, std::ranges::less {}, &stage::sequence);
+    for (auto * s : sorted) { fn(*s); }
+  }
+
+private:
+  std::mutex mutex_;
+  std::deque<stage> stages_;
+};
+
+inline
+auto now_ns(void) -> std::uint64_t {
+  return static_cast<std::uint64_t>(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+} /* namespace detail */
+
+inline
+void report(std::ostream & os) {
+  std::cout.flush();
+  os << "Pipeline stage statistics:\n";
+  detail::registry::instance().visit([&](stage const & s) {
+    auto const in = s.elements_in.load(std::memory_order_relaxed);
+    auto const out = s.elements_out.load(std::memory_order_relaxed);
+    char line[256];
+    std::snprintf(line, sizeof line,
+                  "  %-24s in %10llu  out %10llu  sel %6.2f%%"
+                  "  pred %10llu  fn %10llu  %12llu ns  %10llu B\n",
+                  s.name.c_str(),
+                  static_cast<unsigned long long>(in),
+                  static_cast<unsigned long long>(out),
+                  in == 0 ? 0.0 : 100.0 * static_cast<double>(out) / static_cast<double>(in),
+                  static_cast<unsigned long long>(s.pred_calls.load(std::memory_order_relaxed)),
+                  static_cast<unsigned long long>(s.fn_calls.load(std::memory_order_relaxed)),
+                  static_cast<unsigned long long>(s.nanoseconds.load(std::memory_order_relaxed)),
+                  static_cast<unsigned long long>(s.bytes.load(std::memory_order_relaxed)));
+    os << line;
+  });
+  os << std::endl;
+  return;
+}
+
+//  MARK: - Instrumented Callables
+template <typename Pred>
+class counted_filter {
+public:
+  counted_filter(stage * s, Pred pred) : stage_(s), pred_(std::move(pred)) {}
+
+  template <typename... Args>
+  auto operator()(Args &&... args) const -> bool {
+    auto const t0 = detail::now_ns();
+    auto const keep = static_cast<bool>(std::invoke(pred_, std::forward<Args>(args)...));
+    stage_->nanoseconds.fetch_add(detail::now_ns() - t0, std::memory_order_relaxed);
+    stage_->pred_calls.fetch_add(1, std::memory_order_relaxed);
+    stage_->elements_in.fetch_add(1, std::memory_order_relaxed);
+    stage_->elements_out.fetch_add(keep, std::memory_order_relaxed);
+    return keep;
+  }
+
+private:
+  stage * stage_;
+  Pred pred_;
+};
+
+template <typename Fn>
+class counted_transform {
+public:
+  counted_transform(stage * s, Fn fn) : stage_(s), fn_(std::move(fn)) {}
+
+  template <typename... Args>
+  decltype(auto) operator()(Args &&... args) const {
+    auto const t0 = detail::now_ns();
+    decltype(auto) result = std::invoke(fn_, std::forward<Args>(args)...);
+    stage_->nanoseconds.fetch_add(detail::now_ns() - t0, std::memory_order_relaxed);
+    stage_->fn_calls.fetch_add(1, std::memory_order_relaxed);
+    stage_->elements_in.fetch_add(1, std::memory_order_relaxed);
+    stage_->elements_out.fetch_add(1, std::memory_order_relaxed);
+    return result;
+  }
+
+private:
+  stage * stage_;
+  Fn fn_;
+};
+
+/*
+ *  stage_probe
+ *
+ *  Handle for stages that do their own accounting, such as views
+ *  that keep auxiliary buffers.  A default-constructed probe
+ *  records nothing.
+ */
+class stage_probe {
+public:
+  stage_probe(void) = default;
+  explicit stage_probe(stage * s) : stage_(s) {}
+
+  void add_in(std::uint64_t n) const { add(&stage::elements_in, n); }
+  void add_out(std::uint64_t n) const { add(&stage::elements_out, n); }
+  void add_pred_calls(std::uint64_t n) const { add(&stage::pred_calls, n); }
+  void add_nanoseconds(std::uint64_t n) const { add(&stage::nanoseconds, n); }
+  void add_bytes(std::uint64_t n) const { add(&stage::bytes, n); }
+
+private:
+  void add(std::atomic<std::uint64_t> stage::* field, std::uint64_t n) const {
+    if (stage_ != nullptr) { (stage_->*field).fetch_add(n, std::memory_order_relaxed); }
+  }
+
+  stage * stage_ = nullptr;
+};
+
+//  MARK: - Public Wrappers
+/*
+ *  count_filter(name, pred)     use in place of pred in views::filter
+ *  count_transform(name, fn)    use in place of fn in views::transform
+ *  count_elements(name)         adaptor counting elements that pass
+ */
+template <typename Pred>
+auto count_filter(char const * name, Pred pred) {
+  return counted_filter<Pred>(detail::registry::instance().add(name), std::move(pred));
+}
+
+template <typename Fn>
+auto count_transform(char const * name, Fn fn) {
+  return counted_transform<Fn>(detail::registry::instance().add(name), std::move(fn));
+}
+
+/*
+ *  make_probe(name)             stage_probe for a named stage, or an
+ *                               inert probe when name is null
+ */
+inline
+auto make_probe(char const * name) -> stage_probe {
+  return name == nullptr ? stage_probe()
+                         : stage_probe(detail::registry::instance().add(name));
+}
+
+inline
+auto count_elements(char const * name) {
+  auto * const s = detail::registry::instance().add(name);
+  return std::views::transform([s](auto && v) -> decltype(auto) {
+    s->elements_in.fetch_add(1, std::memory_order_relaxed);
+    s->elements_out.fetch_add(1, std::memory_order_relaxed);
+    if constexpr (std::is_lvalue_reference_v<decltype(v)>) {
+      return v;
+    }
+    else {
+      return std::remove_cvref_t<decltype(v)>(std::move(v));
+    }
+  });
+}
+
+#else   /* AVI_PIPELINE_STATS */
+
+inline
+void report(void) {}
+
+template <typename Pred>
+constexpr auto count_filter(char const *, Pred pred) -> Pred { return pred; }
+
+template <typename Fn>
+constexpr auto count_transform(char const *, Fn fn) -> Fn { return fn; }
+
+constexpr auto count_elements(char const *) { return std::views::all; }
+
+struct stage_probe {
+  constexpr void add_in(unsigned long long) const {}
+  constexpr void add_out(unsigned long long) const {}
+  constexpr void add_pred_calls(unsigned long long) const {}
+  constexpr void add_nanoseconds(unsigned long long) const {}
+  constexpr void add_bytes(unsigned long long) const {}
+};
+
+constexpr auto make_probe(char const *) -> stage_probe { return {}; }
+
+#endif  /* AVI_PIPELINE_STATS */
+
+} /* namespace stats */
+} /* namespace avi */
+
+#endif /* pipeline_stats_h */
@@ -0,0 +1,242 @@
+//
+//  radix_sort.h
+//  CF.STL_Ranges_00
+//
+//  Parallel LSD radix sort for integers, and a sort action for
+//  pipelines built on it.
+//
+
+#ifndef radix_sort_h
+#define radix_sort_h
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "parallel_pipeline.h"
+
+namespace avi {
+namespace parallel {
+
+/*
+ *  Below this many elements std::ranges::sort wins: the radix
+ *  passes and the scratch buffer cost more than they save.
+ */
+inline constexpr std::size_t radix_cutoff = 64 * 1024;
+
+template <typename T>
+concept radix_sortable = std::integral<T> && !std::same_as<T, bool>;
+
+namespace detail {
+
+inline constexpr std::size_t radix_bits = 8;
+inline constexpr std::size_t radix_buckets = std::size_t { 1 } << radix_bits;
+
+using radix_histogram = std::array<std::size_t, radix_buckets>;
+
+/*
+ *  Map T onto an unsigned key whose natural order is the wanted
+ *  order: flip the sign bit of signed types, then all bits for a
+ *  descending sort.
+ */
+template <radix_sortable T>
+constexpr auto radix_key(T v, bool descending) -> std::make_unsigned_t<T> {
+  using key_type = std::make_unsigned_t<T>;
+  auto key = static_cast<key_type>(v);
+  if constexpr (std::is_signed_v<T>) {
+    key ^= key_type { 1 } << (sizeof(T) * 8 - 1);
+  }
+  return descending ? static_cast<key_type>(~key) : key;
+}
+
+template <radix_sortable T>
+constexpr auto radix_digit(T v, bool descending, std::size_t shift) -> std::size_t {
+  return static_cast<std::size_t>(radix_key(v, descending) >> shift) & (radix_buckets - 1);
+}
+
+} /* namespace detail */
+
+//  MARK: - Radix Sort
+/*
+ *  radix_sort(rng [, ord])
+ *
+ *  Sort a contiguous range of integers in place, ascending (or
+ *  descending for order::reversed), one 8-bit digit per pass from
+ *  least to most significant.  Each pass is three steps across the
+ *  pool's workers:
+ *
+ *    histogram  every chunk counts its digits;
+ *    offsets    a prefix sum over (digit, chunk) gives each chunk
+ *               its own write cursor per bucket;
+ *    scatter    every chunk moves its elements to the cursors,
+ *               from the current buffer to the other one.
+ *
+ *  The two buffers (rng and one scratch array) swap roles after
+ *  every pass.  One counting pass up front finds the digits that
+ *  are the same in every element, e.g. the high bytes of small
+ *  values, and those passes are skipped.  The sort is stable, so
+ *  equal keys keep their order.  Inputs under radix_cutoff go to
+ *  std::ranges::sort.
+ */
+template <std::ranges::contiguous_range R>
+  requires std::ranges::sized_range<R>
+        && radix_sortable<std::ranges::range_value_t<R>>
+void radix_sort(R && rng, order ord = order::forward) {
+  using value_type = std::ranges::range_value_t<R>;
+  constexpr auto passes = sizeof(value_type) * 8 / detail::radix_bits;
+
+  auto * const data = std::ranges::data(rng);
+  auto const n = static_cast<std::size_t>(std::ranges::size(rng));
+  auto const descending = ord == order::reversed;
+
+  if (n < radix_cutoff) {
+    if (descending) { std::ranges::sort(data, data + n, std::ranges::greater {}); }
+    else            { std::ranges::sort(data, data + n); }
+    return;
+  }
+
+  auto const chunks = chunk_count(n);
+  auto const lo = [&](std::size_t c) { return n * c / chunks; };
+
+  // Every digit of every element, counted per chunk
+  auto all = std::vector<std::array<detail::radix_histogram, passes>>(chunks);
+  for_each_chunk(chunks, [&](std::size_t c) {
+    auto & h = all[c];
+    for (auto i = lo(c); i < lo(c + 1); ++i) {
+      auto const key = detail::radix_key(data[i], descending);
+      for (auto p = std::size_t { 0 }; p < passes; ++p) {
+        ++h[p][static_cast<std::size_t>(key >> (p * detail::radix_bits))
+               & (detail::radix_buckets - 1)];
+      }
+    }
+  });
+
+  auto needed = std::array<bool, passes> {};
+  for (auto p = std::size_t { 0 }; p < passes; ++p) {
+    for (auto d = std::size_t { 0 }; d < detail::radix_buckets; ++d) {
+      auto total = std::size_t { 0 };
+      for (auto c = std::size_t { 0 }; c < chunks; ++c) { total += all[c][p][d]; }
+      if (total != 0) {
+        needed[p] = total != n;
+        break;
+      }
+    }
+  }
+
+  auto scratch = std::make_unique_for_overwrite<value_type[]>(n);
+  auto * src = data;
+  auto * dst = scratch.get();
+  auto hist = std::vector<detail::radix_histogram>(chunks);
+  auto counted = true;
+
+  for (auto p = std::size_t { 0 }; p < passes; ++p) {
+    if (!needed[p]) { continue; }
+    auto const shift = p * detail::radix_bits;
+
+    // Until the first scatter the up-front counts still describe
+    // each chunk; after it the data has moved and is recounted
+    if (counted) {
+      for (auto c = std::size_t { 0 }; c < chunks; ++c) { hist[c] = all[c][p]; }
+      counted = false;
+    }
+    else {
+      for_each_chunk(chunks, [&](std::size_t c) {
+        auto & h = hist[c];
+        h.fill(0);
+        for (auto i = lo(c); i < lo(c + 1); ++i) {
+          ++h[detail::radix_digit(src[i], descending, shift)];
+        }
+      });
+    }
+
+    auto running = std::size_t { 0 };
+    for (auto d = std::size_t { 0 }; d < detail::radix_buckets; ++d) {
+      for (auto c = std::size_t { 0 }; c < chunks; ++c) {
+        running += std::exchange(hist[c][d], running);
+      }
+    }
+
+    for_each_chunk(chunks, [&](std::size_t c) {
+      auto & cursor = hist[c];
+      for (auto i = lo(c); i < lo(c + 1); ++i) {
+        dst[cursor[detail::radix_digit(src[i], descending, shift)]++] = src[i];
+      }
+    });
+    std::swap(src, dst);
+  }
+
+  if (src != data) {
+    for_each_chunk(chunks, [&](std::size_t c) {
+      std::copy(src + lo(c), src + lo(c + 1), data + lo(c));
+    });
+  }
+  return;
+}
+
+} /* namespace parallel */
+
+//  MARK: - Sort Action
+/*
+ *  sort([ord])
+ *
+ *  Pipe action that returns the elements of a range sorted:
+ *
+ *    auto sorted = numbers | views::filter(is_even) | avi::sort();
+ *
+ *  The range is materialized into a std::vector (an rvalue vector
+ *  is taken over instead of copied) and sorted with
+ *  parallel::radix_sort when the elements are integers, or
+ *  std::ranges::sort otherwise.  order::reversed sorts descending.
+ */
+struct sort_closure {
+  parallel::order ord = parallel::order::forward;
+
+  template <std::ranges::input_range R>
+  auto operator()(R && rng) const {
+    using value_type = std::ranges::range_value_t<R>;
+    auto out = std::vector<value_type>();
+    if constexpr (std::same_as<std::remove_cvref_t<R>, std::vector<value_type>>
+                  && !std::is_lvalue_reference_v<R>) {
+      out = std::move(rng);
+    }
+    else {
+      if constexpr (std::ranges::sized_range<R>) {
+        out.reserve(static_cast<std::size_t>(std::ranges::size(rng)));
+      }
+      std::ranges::copy(rng, std::back_inserter(out));
+    }
+
+    if constexpr (parallel::radix_sortable<value_type>) {
+      parallel::radix_sort(out, ord);
+    }
+    else if (ord == parallel::order::reversed) {
+      std::ranges::sort(out, std::ranges::greater {});
+    }
+    else {
+      std::ranges::sort(out);
+    }
+    return out;
+  }
+
+  template <std::ranges::input_range R>
+  friend auto operator|(R && rng, sort_closure const & self) {
+    return self(std::forward<R>(rng));
+  }
+};
+
+inline
+auto sort(parallel::order ord = parallel::order::forward) -> sort_closure {
+  return sort_closure { ord };
+}
+
+} /* namespace avi */
+
+#endif /* radix_sort_h */
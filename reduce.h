@@ -0,0 +1,533 @@
+//
+//  reduce.h
+//  CF.STL_Ranges_00
+//
+//  Reduction terminals (sum, min, max, minmax, count) for the end
+//  of a pipeline.
+//
+
+#ifndef reduce_h
+#define reduce_h
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "parallel_pipeline.h"
+
+#if defined(__AVX2__)
+#   include <immintrin.h>
+#endif
+
+namespace avi {
+namespace reduce {
+
+namespace detail {
+
+//  MARK: - Accumulators
+/*
+ *  Integers are summed in 64 bits and float in double, so adding
+ *  up a long range of small elements does not overflow or lose
+ *  the low digits.
+ */
+template <typename T>
+using wide_t =
+  std::conditional_t<std::is_floating_point_v<T>,
+    std::conditional_t<(sizeof(T) < sizeof(double)), double, T>,
+    std::conditional_t<std::is_signed_v<T>, std::int64_t, std::uint64_t>>;
+
+template <typename T>
+constexpr auto highest(void) -> T {
+  if constexpr (std::numeric_limits<T>::has_infinity) { return std::numeric_limits<T>::infinity(); }
+  else { return std::numeric_limits<T>::max(); }
+}
+
+template <typename T>
+constexpr auto lowest(void) -> T {
+  if constexpr (std::numeric_limits<T>::has_infinity) { return -std::numeric_limits<T>::infinity(); }
+  else { return std::numeric_limits<T>::lowest(); }
+}
+
+/*
+ *  Each operation folds elements into an accumulator starting
+ *  from identity(); combine() merges two partial results.  The
+ *  element count is kept alongside by the driver.
+ */
+template <typename T>
+struct sum_op {
+  using acc_type = wide_t<T>;
+  static constexpr auto identity(void) -> acc_type { return acc_type {}; }
+  static constexpr auto step(acc_type a, T v) -> acc_type { return a + static_cast<acc_type>(v); }
+  static constexpr auto combine(acc_type a, acc_type b) -> acc_type { return a + b; }
+};
+
+template <typename T>
+struct min_op {
+  using acc_type = T;
+  static constexpr auto identity(void) -> acc_type { return highest<T>(); }
+  static constexpr auto step(acc_type a, T v) -> acc_type { return v < a ? v : a; }
+  static constexpr auto combine(acc_type a, acc_type b) -> acc_type { return step(a, b); }
+};
+
+template <typename T>
+struct max_op {
+  using acc_type = T;
+  static constexpr auto identity(void) -> acc_type { return lowest<T>(); }
+  static constexpr auto step(acc_type a, T v) -> acc_type { return a < v ? v : a; }
+  static constexpr auto combine(acc_type a, acc_type b) -> acc_type { return step(a, b); }
+};
+
+template <typename T>
+struct minmax_op {
+  using acc_type = std::ranges::min_max_result<T>;
+  static constexpr auto identity(void) -> acc_type { return { highest<T>(), lowest<T>() }; }
+  static constexpr auto step(acc_type a, T v) -> acc_type {
+    return { min_op<T>::step(a.min, v), max_op<T>::step(a.max, v) };
+  }
+  static constexpr auto combine(acc_type a, acc_type b) -> acc_type {
+    return { min_op<T>::step(a.min, b.min), max_op<T>::step(a.max, b.max) };
+  }
+};
+
+/*
+ *  count needs nothing but the element count.
+ */
+template <typename T>
+struct count_op {
+  using acc_type = std::size_t;
+  static constexpr auto identity(void) -> acc_type { return 0; }
+  static constexpr auto step(acc_type a, T) -> acc_type { return a; }
+  static constexpr auto combine(acc_type a, acc_type) -> acc_type { return a; }
+};
+
+template <typename Op>
+struct partial {
+  typename Op::acc_type acc = Op::identity();
+  std::size_t count = 0;
+
+  static constexpr auto combine(partial a, partial b) -> partial {
+    return { Op::combine(a.acc, b.acc), a.count + b.count };
+  }
+};
+
+struct keep_all {
+  constexpr auto operator()(auto const &) const -> bool { return true; }
+};
+
+//  MARK: - Scalar Kernel
+/*
+ *  Four independent accumulators over random-access input, so
+ *  consecutive steps do not wait on each other; a filtered element
+ *  is folded with a select rather than a branch.
+ */
+template <typename Op, typename T, std::input_iterator I, std::sentinel_for<I> S, typename Pred>
+auto fold_scalar(I first, S last, Pred const & pred) -> partial<Op> {
+  auto a0 = Op::identity();
+  auto a1 = Op::identity();
+  auto a2 = Op::identity();
+  auto a3 = Op::identity();
+  auto count = std::size_t { 0 };
+
+  auto const fold1 = [&](auto & acc, auto && ref) {
+    auto const v = static_cast<T>(ref);
+    auto const keep = static_cast<bool>(std::invoke(pred, v));
+    auto const next = Op::step(acc, v);
+    acc = keep ? next : acc;
+    count += keep;
+  };
+
+  if constexpr (std::random_access_iterator<I> && std::sized_sentinel_for<S, I>) {
+    auto const n = last - first;
+    auto i = std::iter_difference_t<I> { 0 };
+    for (; i + 4 <= n; i += 4) {
+      fold1(a0, first[i]);
+      fold1(a1, first[i + 1]);
+      fold1(a2, first[i + 2]);
+      fold1(a3, first[i + 3]);
+    }
+    for (; i < n; ++i) { fold1(a0, first[i]); }
+  }
+  else {
+    for (; first != last; ++first) { fold1(a0, *first); }
+  }
+  return { Op::combine(Op::combine(a0, a1), Op::combine(a2, a3)), count };
+}
+
+//  MARK: - SIMD Kernel
+#if defined(__AVX2__)
+/*
+ *  Predicates with a vector form (avi::simd predicates, avi::expr
+ *  comparisons) narrow each register of eight ints with a lane
+ *  mask; keep_all needs none.
+ */
+template <typename Pred>
+inline constexpr bool has_lane_mask =
+  std::same_as<Pred, keep_all>
+  || requires (Pred const & p, __m256i v) { _mm256_castsi256_ps(p.mask(v)); };
+
+template <typename Pred>
+inline
+auto lane_mask(Pred const & pred, __m256i v) -> __m256i {
+  if constexpr (std::same_as<Pred, keep_all>) { return _mm256_set1_epi32(-1); }
+  else { return pred.mask(v); }
+}
+
+/*
+ *  Fold n ints with two registers of state per op (four 64-bit
+ *  sum lanes per register, so eight independent sums), then
+ *  reduce the lanes and finish the tail with the scalar kernel.
+ */
+template <typename Op, typename Pred>
+auto fold_simd(int const * p, std::size_t n, Pred const & pred) -> partial<Op> {
+  constexpr bool is_sum = std::same_as<Op, sum_op<int>>;
+  constexpr bool wants_min = std::same_as<Op, min_op<int>> || std::same_as<Op, minmax_op<int>>;
+  constexpr bool wants_max = std::same_as<Op, max_op<int>> || std::same_as<Op, minmax_op<int>>;
+
+  auto const hi_id = _mm256_set1_epi32(highest<int>());
+  auto const lo_id = _mm256_set1_epi32(lowest<int>());
+  __m256i sum[2] = { _mm256_setzero_si256(), _mm256_setzero_si256() };
+  __m256i mn[2] = { hi_id, hi_id };
+  __m256i mx[2] = { lo_id, lo_id };
+  auto count = std::size_t { 0 };
+
+  auto const fold8 = [&](int const * q, __m256i & s, __m256i & lo, __m256i & hi) {
+    auto const v = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(q));
+    auto const m = lane_mask(pred, v);
+    count += static_cast<std::size_t>(
+      std::popcount(static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(m)))));
+    if constexpr (is_sum) {
+      auto const kept = _mm256_and_si256(v, m);
+      s = _mm256_add_epi64(s, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(kept)));
+      s = _mm256_add_epi64(s, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(kept, 1)));
+    }
+    if constexpr (wants_min) {
+      lo = _mm256_min_epi32(lo, _mm256_blendv_epi8(hi_id, v, m));
+    }
+    if constexpr (wants_max) {
+      hi = _mm256_max_epi32(hi, _mm256_blendv_epi8(lo_id, v, m));
+    }
+  };
+
+  auto i = std::size_t { 0 };
+  for (; i + 16 <= n; i += 16) {
+    fold8(p + i,     sum[0], mn[0], mx[0]);
+    fold8(p + i + 8, sum[1], mn[1], mx[1]);
+  }
+  for (; i + 8 <= n; i += 8) {
+    fold8(p + i, sum[0], mn[0], mx[0]);
+  }
+
+  auto result = fold_scalar<Op, int>(p + i, p + n, pred);
+  result.count += count;
+  if constexpr (is_sum) {
+    alignas(32) std::int64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), _mm256_add_epi64(sum[0], sum[1]));
+    result.acc += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  }
+  else if constexpr (!std::same_as<Op, count_op<int>>) {
+    alignas(32) int lanes_min[8];
+    alignas(32) int lanes_max[8];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes_min), _mm256_min_epi32(mn[0], mn[1]));
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes_max), _mm256_max_epi32(mx[0], mx[1]));
+    for (auto j = 0; j < 8; ++j) {
+      if constexpr (std::same_as<Op, min_op<int>>) { result.acc = Op::step(result.acc, lanes_min[j]); }
+      if constexpr (std::same_as<Op, max_op<int>>) { result.acc = Op::step(result.acc, lanes_max[j]); }
+      if constexpr (std::same_as<Op, minmax_op<int>>) {
+        result.acc = Op::combine(result.acc, { lanes_min[j], lanes_max[j] });
+      }
+    }
+  }
+  return result;
+}
+#endif
+
+/*
+ *  Fold the chunk [lo, hi) of a random-access source.
+ */
+template <typename Op, typename T, typename Src, typename Pred>
+auto fold_chunk(Src & src, std::size_t lo, std::size_t hi, Pred const & pred) -> partial<Op> {
+#if defined(__AVX2__)
+  if constexpr (std::ranges::contiguous_range<Src>
+                && std::same_as<std::ranges::range_value_t<Src>, int>
+                && std::same_as<T, int>
+                && has_lane_mask<Pred>) {
+    return fold_simd<Op>(std::ranges::data(src) + lo, hi - lo, pred);
+  }
+#endif
+  auto const first = std::ranges::begin(src);
+  return fold_scalar<Op, T>(first + static_cast<std::ptrdiff_t>(lo),
+                            first + static_cast<std::ptrdiff_t>(hi), pred);
+}
+
+/*
+ *  The iterator of a filter_view or transform_view at current.
+ *  The standard gives both a (parent, base iterator) constructor;
+ *  libstdc++ takes the parent by pointer.
+ */
+template <typename It, typename Parent, typename I>
+auto iterator_at(Parent & parent, I current) -> It {
+  if constexpr (std::constructible_from<It, Parent &, I>) {
+    return It(parent, std::move(current));
+  }
+  else {
+    return It(std::addressof(parent), std::move(current));
+  }
+}
+
+/*
+ *  Fold the chunk [lo, hi) of the base of views::filter under
+ *  views::transform (rng, over filtered, over base).  Each element
+ *  the filter keeps is read through rng's own iterator, so the
+ *  transform is applied to those elements only, as it is when rng
+ *  is iterated.  The survivors of a batch are picked first, with a
+ *  branch-free store-and-advance, so an unpredictable predicate
+ *  costs no mispredicted branches.
+ */
+template <typename Op, typename T, typename R, typename Filter, typename Base>
+auto fold_transformed(R & rng, Filter & filtered, Base & base, std::size_t lo, std::size_t hi)
+    -> partial<Op> {
+  using filter_iterator = std::ranges::iterator_t<Filter>;
+  using transform_iterator = std::ranges::iterator_t<R>;
+  constexpr std::size_t batch = 256;
+
+  auto const & pred = filtered.pred();
+  auto result = partial<Op> {};
+  auto picked = std::array<std::uint32_t, batch> {};
+  auto const first = std::ranges::begin(base);
+  for (auto b = lo; b < hi; b += batch) {
+    auto const at = first + static_cast<std::ptrdiff_t>(b);
+    auto const k = std::min(batch, hi - b);
+    auto m = std::size_t { 0 };
+    for (auto j = std::size_t { 0 }; j < k; ++j) {
+      picked[m] = static_cast<std::uint32_t>(j);
+      m += static_cast<bool>(std::invoke(pred, at[static_cast<std::ptrdiff_t>(j)]));
+    }
+    for (auto j = std::size_t { 0 }; j < m; ++j) {
+      auto const it = iterator_at<transform_iterator>(
+        rng, iterator_at<filter_iterator>(filtered, at + static_cast<std::ptrdiff_t>(picked[j])));
+      result.acc = Op::step(result.acc, static_cast<T>(*it));
+    }
+    result.count += m;
+  }
+  return result;
+}
+
+//  MARK: - Driver
+/*
+ *  Split n elements into chunks on the shared pool, fold each with
+ *  fold(lo, hi), and combine the per-chunk partials pairwise as a
+ *  tree.  Partials sit on their own cache lines.
+ */
+template <typename Op, typename ChunkFold>
+auto fold_chunks(std::size_t n, ChunkFold const & fold) -> partial<Op> {
+  struct alignas(parallel::cache_line) slot { partial<Op> value; };
+
+  auto const chunks = parallel::chunk_count(n);
+  auto parts = std::vector<slot>(chunks);
+  parallel::for_each_chunk(chunks, [&](std::size_t c) {
+    parts[c].value = fold(n * c / chunks, n * (c + 1) / chunks);
+  });
+
+  for (auto stride = std::size_t { 1 }; stride < chunks; stride *= 2) {
+    for (auto c = std::size_t { 0 }; c + stride < chunks; c += 2 * stride) {
+      parts[c].value = partial<Op>::combine(parts[c].value, parts[c + stride].value);
+    }
+  }
+  return parts.empty() ? partial<Op> {} : parts[0].value;
+}
+
+/*
+ *  A sized random-access source folded in parallel chunks.
+ */
+template <typename Op, typename T, typename Src, typename Pred>
+auto fold_parallel(Src & src, Pred const & pred) -> partial<Op> {
+  return fold_chunks<Op>(static_cast<std::size_t>(std::ranges::size(src)),
+                         [&](std::size_t lo, std::size_t hi) {
+                           return fold_chunk<Op, T>(src, lo, hi, pred);
+                         });
+}
+
+template <typename T>
+struct filter_shape : std::false_type {};
+
+template <typename V, typename P>
+struct filter_shape<std::ranges::filter_view<V, P>> : std::true_type {};
+
+/*
+ *  views::filter whose base can be split into chunks.
+ */
+template <typename R>
+concept splittable_filter =
+  filter_shape<std::remove_cvref_t<R>>::value
+  && requires (R & rng) {
+       { rng.base() } -> std::ranges::random_access_range;
+       { rng.base() } -> std::ranges::sized_range;
+     };
+
+template <typename T>
+struct transform_shape : std::false_type {};
+
+template <typename V, typename F>
+struct transform_shape<std::ranges::transform_view<V, F>> : std::true_type {};
+
+/*
+ *  views::transform over a splittable views::filter.
+ */
+template <typename R>
+concept splittable_transform =
+  transform_shape<std::remove_cvref_t<R>>::value
+  && requires (R & rng) { { rng.base() } -> splittable_filter; };
+
+/*
+ *  Pick the fastest way to fold rng:
+ *
+ *    sized random-access (contiguous int uses SIMD)   in parallel
+ *    views::filter over a sized random-access base    in parallel,
+ *        the predicate applied as a mask
+ *    views::transform over such a filter              in parallel,
+ *        split on the filter's base
+ *    anything else                                    in one pass
+ *
+ *  sequential folds the first three as a single chunk on the
+ *  calling thread.
+ */
+template <template <typename> class OpT, std::ranges::input_range R>
+auto fold(R && rng, bool sequential) {
+  using value_type = std::ranges::range_value_t<R>;
+  using op = OpT<value_type>;
+
+  if constexpr (std::ranges::random_access_range<R> && std::ranges::sized_range<R>) {
+    if (sequential) {
+      return fold_chunk<op, value_type>(rng, 0, static_cast<std::size_t>(std::ranges::size(rng)),
+                                        keep_all {});
+    }
+    return fold_parallel<op, value_type>(rng, keep_all {});
+  }
+  else if constexpr (splittable_filter<R>) {
+    auto base = rng.base();
+    if (sequential) {
+      return fold_chunk<op, value_type>(base, 0, static_cast<std::size_t>(std::ranges::size(base)),
+                                        rng.pred());
+    }
+    return fold_parallel<op, value_type>(base, rng.pred());
+  }
+  else if constexpr (splittable_transform<R>) {
+    auto filtered = rng.base();
+    auto base = filtered.base();
+    auto const n = static_cast<std::size_t>(std::ranges::size(base));
+    auto const chunk = [&](std::size_t lo, std::size_t hi) {
+      return fold_transformed<op, value_type>(rng, filtered, base, lo, hi);
+    };
+    if (sequential) { return chunk(0, n); }
+    return fold_chunks<op>(n, chunk);
+  }
+  else {
+    return fold_scalar<op, value_type>(std::ranges::begin(rng), std::ranges::end(rng),
+                                       keep_all {});
+  }
+}
+
+} /* namespace detail */
+
+//  MARK: - Terminals
+/*
+ *  Pipe terminals:
+ *
+ *    numbers | views::filter(is_even) | avi::reduce::sum()      -> int64_t
+ *    numbers | avi::reduce::min()                              -> optional<int>
+ *    numbers | avi::reduce::minmax()                           -> optional<min_max_result<int>>
+ *    numbers | views::filter(is_even) | avi::reduce::count()    -> size_t
+ *
+ *  sum() widens (integers to 64 bits, float to double).  min, max
+ *  and minmax of an empty range are std::nullopt.  Sized random-
+ *  access ranges, views::filter over one, and views::transform
+ *  over such a filter are reduced in parallel chunks; contiguous
+ *  ints with AVX2 in vector registers.  Other ranges (longer
+ *  chains, or filters over other ranges) are reduced in a single
+ *  pass with several accumulators.
+ *
+ *  In parallel chunks the filter's predicate, and any transform
+ *  behind a random-access range, run on several threads at once:
+ *  they must be thread-safe and free of side effects.  sum(seq)
+ *  and the like reduce on the calling thread alone.
+ */
+template <typename Closure>
+struct terminal {
+  bool sequential = false;
+
+  template <std::ranges::input_range R>
+  friend auto operator|(R && rng, Closure const & self) {
+    return self(std::forward<R>(rng));
+  }
+};
+
+struct sum_closure : terminal<sum_closure> {
+  template <std::ranges::input_range R>
+  auto operator()(R && rng) const {
+    return detail::fold<detail::sum_op>(std::forward<R>(rng), this->sequential).acc;
+  }
+};
+
+struct min_closure : terminal<min_closure> {
+  template <std::ranges::input_range R>
+  auto operator()(R && rng) const -> std::optional<std::ranges::range_value_t<R>> {
+    auto const r = detail::fold<detail::min_op>(std::forward<R>(rng), this->sequential);
+    if (r.count == 0) { return std::nullopt; }
+    return r.acc;
+  }
+};
+
+struct max_closure : terminal<max_closure> {
+  template <std::ranges::input_range R>
+  auto operator()(R && rng) const -> std::optional<std::ranges::range_value_t<R>> {
+    auto const r = detail::fold<detail::max_op>(std::forward<R>(rng), this->sequential);
+    if (r.count == 0) { return std::nullopt; }
+    return r.acc;
+  }
+};
+
+struct minmax_closure : terminal<minmax_closure> {
+  template <std::ranges::input_range R>
+  auto operator()(R && rng) const
+      -> std::optional<std::ranges::min_max_result<std::ranges::range_value_t<R>>> {
+    auto const r = detail::fold<detail::minmax_op>(std::forward<R>(rng), this->sequential);
+    if (r.count == 0) { return std::nullopt; }
+    return r.acc;
+  }
+};
+
+struct count_closure : terminal<count_closure> {
+  template <std::ranges::input_range R>
+  auto operator()(R && rng) const -> std::size_t {
+    return detail::fold<detail::count_op>(std::forward<R>(rng), this->sequential).count;
+  }
+};
+
+inline auto sum(void)    -> sum_closure    { return {}; }
+inline auto min(void)    -> min_closure    { return {}; }
+inline auto max(void)    -> max_closure    { return {}; }
+inline auto minmax(void) -> minmax_closure { return {}; }
+inline auto count(void)  -> count_closure  { return {}; }
+
+inline auto sum(parallel::sequenced_policy)    -> sum_closure    { return { { true } }; }
+inline auto min(parallel::sequenced_policy)    -> min_closure    { return { { true } }; }
+inline auto max(parallel::sequenced_policy)    -> max_closure    { return { { true } }; }
+inline auto minmax(parallel::sequenced_policy) -> minmax_closure { return { { true } }; }
+inline auto count(parallel::sequenced_policy)  -> count_closure  { return { { true } }; }
+
+} /* namespace reduce */
+} /* namespace avi */
+
+#endif /* reduce_h */
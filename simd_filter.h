@@ -0,0 +1,391 @@
+//
+//  simd_filter.h
+//  CF.STL_Ranges_00
+//
+//  Block-masked filter view adaptor for contiguous int ranges.
+//
+
+#ifndef simd_filter_h
+#define simd_filter_h
+
+#include <algorithm>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+
+#include "movable_box.h"
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#   include <immintrin.h>
+#elif defined(__SSE2__)
+#   include <emmintrin.h>
+#endif
+
+namespace avi {
+namespace simd {
+
+//  MARK: - Vector Predicates
+/*
+ *  Predicates with a vector form.  Each is an ordinary callable
+ *  on int, so it can be handed to std::views::filter as well, and
+ *  additionally knows how to test a whole register of lanes.
+ *  Plain lambdas are still accepted by simd_filter; their mask is
+ *  built one lane at a time.  The SSE2 form is what a build
+ *  without -march uses, since every x86-64 target has it.
+ */
+struct is_even {
+  constexpr auto operator()(int n) const -> bool { return (n & 1) == 0; }
+#ifdef __SSE2__
+  auto mask(__m128i v) const -> __m128i {
+    return _mm_cmpeq_epi32(_mm_and_si128(v, _mm_set1_epi32(1)), _mm_setzero_si128());
+  }
+#endif
+#ifdef __AVX2__
+  auto mask(__m256i v) const -> __m256i {
+    return _mm256_cmpeq_epi32(_mm256_and_si256(v, _mm256_set1_epi32(1)),
+                              _mm256_setzero_si256());
+  }
+#endif
+#ifdef __AVX512F__
+  auto mask(__m512i v) const -> __mmask16 {
+    return _mm512_testn_epi32_mask(v, _mm512_set1_epi32(1));
+  }
+#endif
+};
+
+struct is_odd {
+  constexpr auto operator()(int n) const -> bool { return (n & 1) != 0; }
+#ifdef __SSE2__
+  auto mask(__m128i v) const -> __m128i {
+    auto const one = _mm_set1_epi32(1);
+    return _mm_cmpeq_epi32(_mm_and_si128(v, one), one);
+  }
+#endif
+#ifdef __AVX2__
+  auto mask(__m256i v) const -> __m256i {
+    auto const one = _mm256_set1_epi32(1);
+    return _mm256_cmpeq_epi32(_mm256_and_si256(v, one), one);
+  }
+#endif
+#ifdef __AVX512F__
+  auto mask(__m512i v) const -> __mmask16 {
+    return _mm512_test_epi32_mask(v, _mm512_set1_epi32(1));
+  }
+#endif
+};
+
+struct greater_than {
+  int k;
+  constexpr auto operator()(int n) const -> bool { return n > k; }
+#ifdef __SSE2__
+  auto mask(__m128i v) const -> __m128i {
+    return _mm_cmpgt_epi32(v, _mm_set1_epi32(k));
+  }
+#endif
+#ifdef __AVX2__
+  auto mask(__m256i v) const -> __m256i {
+    return _mm256_cmpgt_epi32(v, _mm256_set1_epi32(k));
+  }
+#endif
+#ifdef __AVX512F__
+  auto mask(__m512i v) const -> __mmask16 {
+    return _mm512_cmpgt_epi32_mask(v, _mm512_set1_epi32(k));
+  }
+#endif
+};
+
+struct less_than {
+  int k;
+  constexpr auto operator()(int n) const -> bool { return n < k; }
+#ifdef __SSE2__
+  auto mask(__m128i v) const -> __m128i {
+    return _mm_cmplt_epi32(v, _mm_set1_epi32(k));
+  }
+#endif
+#ifdef __AVX2__
+  auto mask(__m256i v) const -> __m256i {
+    return _mm256_cmpgt_epi32(_mm256_set1_epi32(k), v);
+  }
+#endif
+#ifdef __AVX512F__
+  auto mask(__m512i v) const -> __mmask16 {
+    return _mm512_cmplt_epi32_mask(v, _mm512_set1_epi32(k));
+  }
+#endif
+};
+
+//  MARK: - Mask Kernels
+namespace detail {
+
+/*
+ *  Lane mask for predicates without a vector form: one call per
+ *  lane, combined without branches.
+ */
+template <std::size_t Lanes, typename Pred>
+inline
+auto scalar_mask(int const * src, Pred const & pred) -> unsigned {
+  auto m = 0u;
+  for (auto j = std::size_t { 0 }; j < Lanes; ++j) {
+    m |= static_cast<unsigned>(static_cast<bool>(std::invoke(pred, src[j]))) << j;
+  }
+  return m;
+}
+
+#if defined(__SSE2__) && !defined(__AVX2__)
+template <typename Pred>
+inline
+auto lane_mask4(int const * src, __m128i v, Pred const & pred) -> unsigned {
+  if constexpr (requires { pred.mask(v); }) {
+    return static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(pred.mask(v))));
+  }
+  else {
+    return scalar_mask<4>(src, pred);
+  }
+}
+#endif
+
+#if defined(__AVX2__) && !defined(__AVX512F__)
+template <typename Pred>
+inline
+auto lane_mask8(int const * src, __m256i v, Pred const & pred) -> unsigned {
+  if constexpr (requires { pred.mask(v); }) {
+    return static_cast<unsigned>(
+      _mm256_movemask_ps(_mm256_castsi256_ps(pred.mask(v))));
+  }
+  else {
+    return scalar_mask<8>(src, pred);
+  }
+}
+#endif
+
+#ifdef __AVX512F__
+template <typename Pred>
+inline
+auto lane_mask16(int const * src, __m512i v, Pred const & pred) -> __mmask16 {
+  if constexpr (requires { { pred.mask(v) } -> std::same_as<__mmask16>; }) {
+    return pred.mask(v);
+  }
+  else {
+    return static_cast<__mmask16>(scalar_mask<16>(src, pred));
+  }
+}
+#endif
+
+/*
+ *  One bit per element of src[0, count), count <= 64, set where
+ *  pred holds: the lane masks of whole registers, then one lane at
+ *  a time for the tail.
+ */
+template <typename Pred>
+inline
+auto block_mask(int const * src, std::size_t count, Pred const & pred) -> std::uint64_t {
+  auto m = std::uint64_t { 0 };
+  auto j = std::size_t { 0 };
+#if defined(__AVX512F__)
+  for (; j + 16 <= count; j += 16) {
+    auto const v = _mm512_loadu_si512(src + j);
+    m |= static_cast<std::uint64_t>(lane_mask16(src + j, v, pred)) << j;
+  }
+#elif defined(__AVX2__)
+  for (; j + 8 <= count; j += 8) {
+    auto const v = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(src + j));
+    m |= static_cast<std::uint64_t>(lane_mask8(src + j, v, pred)) << j;
+  }
+#elif defined(__SSE2__)
+  for (; j + 4 <= count; j += 4) {
+    auto const v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src + j));
+    m |= static_cast<std::uint64_t>(lane_mask4(src + j, v, pred)) << j;
+  }
+#endif
+  for (; j < count; ++j) {
+    m |= static_cast<std::uint64_t>(static_cast<bool>(std::invoke(pred, src[j]))) << j;
+  }
+  return m;
+}
+
+} /* namespace detail */
+
+} /* namespace simd */
+
+//  MARK: - View
+/*
+ *  simd_filter_view
+ *
+ *  A lazy filter over a contiguous range of int.  The iterator
+ *  tests a block of 64 elements at a time, with the predicate's
+ *  vector form where it has one, and keeps the block's survivors
+ *  as a 64-bit mask; stepping is a count of trailing (or leading)
+ *  zeros, and the predicate is not called again until the next
+ *  block.  Elements are the source's own, so writes through the
+ *  view reach it and later passes see its current contents.
+ *
+ *  Like std::views::filter, begin() is found once and cached (the
+ *  cache is dropped when the view is copied), and modifying an
+ *  element so that it no longer satisfies the predicate is not
+ *  allowed.
+ */
+template <std::ranges::view V, typename Pred>
+  requires std::ranges::contiguous_range<V>
+        && std::ranges::sized_range<V>
+        && std::same_as<std::ranges::range_value_t<V>, int>
+        && std::predicate<Pred const &, int>
+class simd_filter_view
+  : public std::ranges::view_interface<simd_filter_view<V, Pred>> {
+  static constexpr std::size_t block = 64;
+
+public:
+  class iterator {
+  public:
+    using iterator_concept = std::bidirectional_iterator_tag;
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = int;
+    using difference_type = std::ptrdiff_t;
+
+    iterator(void) = default;
+
+    auto operator*(void) const -> std::ranges::range_reference_t<V> {
+      return std::ranges::data(parent_->base_)[first_ + pos_];
+    }
+    auto operator->(void) const { return std::ranges::data(parent_->base_) + first_ + pos_; }
+
+    auto operator++(void) -> iterator & {
+      if (auto const rest = bits_ & (~std::uint64_t { 1 } << pos_); rest != 0) {
+        pos_ = static_cast<std::size_t>(std::countr_zero(rest));
+      }
+      else { seek_forward(first_ + block); }
+      return *this;
+    }
+    auto operator++(int) -> iterator { auto t = *this; ++*this; return t; }
+
+    auto operator--(void) -> iterator & {
+      if (auto const before = bits_ & ((std::uint64_t { 1 } << pos_) - 1); before != 0) {
+        pos_ = static_cast<std::size_t>(std::bit_width(before)) - 1;
+      }
+      else {
+        do {
+          first_ -= block;
+          bits_ = parent_->mask_at(first_);
+        } while (bits_ == 0);
+        pos_ = static_cast<std::size_t>(std::bit_width(bits_)) - 1;
+      }
+      return *this;
+    }
+    auto operator--(int) -> iterator { auto t = *this; --*this; return t; }
+
+    friend auto operator==(iterator const & a, iterator const & b) -> bool {
+      return a.first_ == b.first_ && a.pos_ == b.pos_;
+    }
+
+  private:
+    friend class simd_filter_view;
+
+    iterator(simd_filter_view * parent, std::size_t first)
+      : parent_(parent), first_(first) {}
+
+    // Move to the first survivor in a block starting at or after
+    // first, or to the end
+    void seek_forward(std::size_t first) {
+      auto const stop = parent_->end_first();
+      for (first_ = first; first_ != stop; first_ += block) {
+        if ((bits_ = parent_->mask_at(first_)) != 0) {
+          pos_ = static_cast<std::size_t>(std::countr_zero(bits_));
+          return;
+        }
+      }
+      bits_ = 0;
+      pos_ = 0;
+    }
+
+    simd_filter_view * parent_ = nullptr;
+    std::size_t first_ = 0;           // start of the current block
+    std::uint64_t bits_ = 0;          // survivors of that block
+    std::size_t pos_ = 0;             // current element within it
+  };
+
+  simd_filter_view(void) requires std::default_initializable<V>
+                               && std::default_initializable<Pred> = default;
+  simd_filter_view(V base, Pred pred)
+    : base_(std::move(base)), pred_(std::move(pred)) {}
+
+  auto base(void) const & -> V requires std::copy_constructible<V> { return base_; }
+  auto base(void) && -> V { return std::move(base_); }
+  auto pred(void) const -> Pred const & { return *pred_; }
+
+  auto begin(void) -> iterator {
+    if (!begin_.has_value()) {
+      auto it = iterator(this, 0);
+      it.seek_forward(0);
+      begin_.emplace(it);
+    }
+    return *begin_;
+  }
+
+  auto end(void) -> iterator { return iterator(this, end_first()); }
+
+private:
+  // The block index one past the last block: the end position
+  auto end_first(void) const -> std::size_t {
+    auto const n = static_cast<std::size_t>(std::ranges::size(base_));
+    return (n + block - 1) / block * block;
+  }
+
+  auto mask_at(std::size_t first) const -> std::uint64_t {
+    auto const n = static_cast<std::size_t>(std::ranges::size(base_));
+    return simd::detail::block_mask(std::ranges::data(base_) + first,
+                                    std::min(block, n - first), *pred_);
+  }
+
+  V base_ = V();
+  detail::movable_box<Pred> pred_;
+  detail::non_propagating_cache<iterator> begin_;
+};
+
+template <typename R, typename Pred>
+simd_filter_view(R &&, Pred) -> simd_filter_view<std::views::all_t<R>, Pred>;
+
+//  MARK: - Adaptor
+/*
+ *  simd_filter(pred)
+ *
+ *  Drop-in for std::views::filter(pred).  Contiguous, sized int
+ *  sources get a simd_filter_view; anything else is passed on to
+ *  std::views::filter unchanged.  Either way the result is a lazy
+ *  bidirectional view of the source's elements.
+ */
+template <typename Pred>
+struct simd_filter_closure {
+  Pred pred;
+
+  template <std::ranges::viewable_range R>
+  auto operator()(R && rng) const {
+    using view_type = std::views::all_t<R>;
+    if constexpr (std::ranges::contiguous_range<view_type>
+                  && std::ranges::sized_range<view_type>
+                  && std::same_as<std::ranges::range_value_t<view_type>, int>) {
+      return simd_filter_view(std::views::all(std::forward<R>(rng)), pred);
+    }
+    else {
+      return std::forward<R>(rng) | std::views::filter(pred);
+    }
+  }
+
+  template <std::ranges::viewable_range R>
+  friend auto operator|(R && rng, simd_filter_closure const & self) {
+    return self(std::forward<R>(rng));
+  }
+};
+
+template <typename Pred>
+auto simd_filter(Pred pred) -> simd_filter_closure<Pred> {
+  return simd_filter_closure<Pred> { std::move(pred) };
+}
+
+} /* namespace avi */
+
+#endif /* simd_filter_h */
@@ -0,0 +1,189 @@
+//
+//  spsc_ring.h
+//  CF.STL_Ranges_00
+//
+//  Bounded, lock-free single-producer / single-consumer ring
+//  buffer used to connect pipeline stages running on their own
+//  threads.
+//
+
+#ifndef spsc_ring_h
+#define spsc_ring_h
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <memory>
+#include <thread>
+
+#include "thread_pool.h"
+
+namespace avi {
+namespace parallel {
+
+namespace detail {
+
+/*
+ *  Spin briefly with the CPU's pause hint, then start yielding so
+ *  that a waiting stage does not starve the one it is waiting on
+ *  when there are fewer cores than stages.
+ */
+class backoff {
+public:
+  void pause(void) {
+    if (spins_ < spin_limit) {
+      ++spins_;
+#if defined(__x86_64__) || defined(__i386__)
+      __builtin_ia32_pause();
+#endif
+    }
+    else {
+      std::this_thread::yield();
+    }
+  }
+
+  void reset(void) { spins_ = 0; }
+
+private:
+  static constexpr unsigned spin_limit = 64;
+  unsigned spins_ = 0;
+};
+
+} /* namespace detail */
+
+//  MARK: - Ring Buffer
+/*
+ *  spsc_ring
+ *
+ *  Exactly one thread may push and exactly one other thread may
+ *  pop.  Capacity is rounded up to a power of two.  Transfers are
+ *  in bulk: one acquire load and one release store per call,
+ *  however many elements move.
+ *
+ *  The consumer's index and the producer's index live on separate
+ *  cache lines, and each side keeps a private copy of the other's
+ *  index, re-reading the shared one only when the ring looks full
+ *  (or empty).  Between refreshes the two cores never touch the
+ *  same line.
+ *
+ *  push() blocks while the ring is full, which is what applies
+ *  backpressure to a fast producer.  pop() blocks while it is
+ *  empty.  The producer close()s the ring when it is done;
+ *  cancel() from either side makes both ends give up, so one
+ *  failing stage can stop the whole pipeline.
+ */
+template <std::default_initializable T>
+class spsc_ring {
+public:
+  explicit spsc_ring(std::size_t capacity)
+    : capacity_(std::bit_ceil(std::max<std::size_t>(capacity, 2))),
+      slots_(std::make_unique<T[]>(capacity_)) {}
+
+  spsc_ring(spsc_ring const &) = delete;
+  auto operator=(spsc_ring const &) -> spsc_ring & = delete;
+
+  auto capacity(void) const -> std::size_t { return capacity_; }
+
+  /*
+   *  Append src[0, n), waiting for room as needed.  Returns false
+   *  if the ring was cancelled first.
+   */
+  auto push(T const * src, std::size_t n) -> bool {
+    auto tail = tail_.load(std::memory_order_relaxed);
+    auto wait = detail::backoff {};
+    while (n != 0) {
+      auto room = capacity_ - (tail - head_cache_);
+      if (room == 0) {
+        head_cache_ = head_.load(std::memory_order_acquire);
+        room = capacity_ - (tail - head_cache_);
+      }
+      if (room == 0) {
+        if (cancelled()) { return false; }
+        wait.pause();
+        continue;
+      }
+
+      auto const k = std::min(room, n);
+      copy_in(tail, src, k);
+      tail += k;
+      tail_.store(tail, std::memory_order_release);
+      src += k;
+      n -= k;
+      wait.reset();
+    }
+    return !cancelled();
+  }
+
+  /*
+   *  Move up to n elements to dst, waiting until at least one is
+   *  available.  Returns 0 only once the ring has been closed and
+   *  drained, or cancelled.
+   */
+  auto pop(T * dst, std::size_t n) -> std::size_t {
+    auto const head = head_.load(std::memory_order_relaxed);
+    auto wait = detail::backoff {};
+    for (;;) {
+      auto ready = tail_cache_ - head;
+      if (ready == 0) {
+        auto const done = closed_.load(std::memory_order_acquire);
+        tail_cache_ = tail_.load(std::memory_order_acquire);
+        ready = tail_cache_ - head;
+        if (ready == 0 && (done || cancelled())) { return 0; }
+      }
+      if (ready == 0) {
+        wait.pause();
+        continue;
+      }
+
+      auto const k = std::min(ready, n);
+      copy_out(head, dst, k);
+      head_.store(head + k, std::memory_order_release);
+      return k;
+    }
+  }
+
+  /*
+   *  No more pushes will follow.  Called by the producer.
+   */
+  void close(void) { closed_.store(true, std::memory_order_release); }
+
+  void cancel(void) { cancelled_.store(true, std::memory_order_release); }
+  auto cancelled(void) const -> bool { return cancelled_.load(std::memory_order_acquire); }
+
+private:
+  void copy_in(std::size_t at, T const * src, std::size_t k) {
+    auto const i = at & (capacity_ - 1);
+    auto const first = std::min(k, capacity_ - i);
+    std::copy_n(src, first, slots_.get() + i);
+    std::copy_n(src + first, k - first, slots_.get());
+  }
+
+  void copy_out(std::size_t at, T * dst, std::size_t k) {
+    auto const i = at & (capacity_ - 1);
+    auto const first = std::min(k, capacity_ - i);
+    std::copy_n(slots_.get() + i, first, dst);
+    std::copy_n(slots_.get(), k - first, dst + first);
+  }
+
+  // Read-only after construction
+  std::size_t const capacity_;
+  std::unique_ptr<T[]> const slots_;
+
+  // Consumer side
+  alignas(cache_line) std::atomic<std::size_t> head_ { 0 };
+  std::size_t tail_cache_ = 0;
+
+  // Producer side
+  alignas(cache_line) std::atomic<std::size_t> tail_ { 0 };
+  std::size_t head_cache_ = 0;
+
+  alignas(cache_line) std::atomic<bool> closed_ { false };
+  std::atomic<bool> cancelled_ { false };
+};
+
+} /* namespace parallel */
+} /* namespace avi */
+
+#endif /* spsc_ring_h */
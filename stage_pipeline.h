@@ -0,0 +1,221 @@
+//
+//  stage_pipeline.h
+//  CF.STL_Ranges_00
+//
+//  Pipeline-parallel execution: the source, every stage and the
+//  sink run on threads of their own, connected by SPSC rings.
+//
+
+#ifndef stage_pipeline_h
+#define stage_pipeline_h
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <ranges>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "batch_engine.h"
+#include "spsc_ring.h"
+
+namespace avi {
+namespace parallel {
+
+struct pipelined_options {
+  std::size_t batch_size = batch::default_batch_size;
+  std::size_t ring_capacity = 16 * 1024;
+};
+
+namespace detail {
+
+/*
+ *  One ring in front of every stage and one behind the last,
+ *  each carrying the element type flowing through that link.
+ */
+template <typename T, typename... Stages>
+struct rings_of {
+  using type = std::tuple<spsc_ring<T>>;
+};
+
+template <typename T, typename S, typename... Rest>
+struct rings_of<T, S, Rest...> {
+  using type = decltype(std::tuple_cat(
+    std::declval<std::tuple<spsc_ring<T>>>(),
+    std::declval<typename rings_of<typename S::template output_t<T>, Rest...>::type>()));
+};
+
+template <typename T, typename Stages>
+struct rings_for;
+
+template <typename T, typename... Stages>
+struct rings_for<T, std::tuple<Stages...>> : rings_of<T, Stages...> {};
+
+/*
+ *  The first exception thrown on any thread wins; it cancels every
+ *  ring so the other threads drain out, and is rethrown by the
+ *  caller once they have all stopped.
+ */
+class failure {
+public:
+  template <typename Rings>
+  void record(Rings & rings) {
+    {
+      auto lock = std::lock_guard(mutex_);
+      if (!error_) { error_ = std::current_exception(); }
+    }
+    std::apply([](auto &... ring) { (ring.cancel(), ...); }, rings);
+  }
+
+  void rethrow(void) {
+    if (error_) { std::rethrow_exception(error_); }
+  }
+
+private:
+  std::mutex mutex_;
+  std::exception_ptr error_;
+};
+
+/*
+ *  Pop batches from in, run the stage over each with a selection
+ *  vector exactly as batch::execute does, and push the surviving
+ *  rows to out.
+ */
+template <typename T, typename Stage, typename U>
+void run_stage(Stage & stage, spsc_ring<T> & in, spsc_ring<U> & out, std::size_t bs) {
+  auto values = std::vector<T>(bs);
+  auto buffer = std::vector<U>(Stage::writes ? bs : 0);
+  auto packed = std::vector<U>(bs);
+  auto sel = batch::selection {};
+  sel.idx.resize(bs);
+
+  for (auto n = in.pop(values.data(), bs); n != 0; n = in.pop(values.data(), bs)) {
+    sel.reset(n);
+    auto const * const result = stage.apply(values.data(), sel, buffer.data());
+    if (sel.count == 0) { continue; }
+
+    auto const * src = result;
+    if (!sel.dense) {
+      for (auto j = std::size_t { 0 }; j < sel.count; ++j) {
+        packed[j] = result[sel.idx[j]];
+      }
+      src = packed.data();
+    }
+    if (!out.push(src, sel.count)) { break; }
+  }
+  out.close();
+}
+
+} /* namespace detail */
+
+//  MARK: - Pipelined Execution
+/*
+ *  pipelined(src, stages, sink [, opts])
+ *
+ *  Run
+ *
+ *    for (auto v : src | stages) { sink(v); }
+ *
+ *  with the source on one thread, each stage of an avi::batch
+ *  pipeline on a thread of its own, and the sink on the calling
+ *  thread.  Adjacent threads are connected by spsc_rings of
+ *  opts.ring_capacity elements and exchange opts.batch_size rows
+ *  at a time, so a slow source (a pipe, a file, a generator) or a
+ *  slow sink (write(2)) overlaps with the compute in between, and
+ *  a full ring holds back whatever is upstream of it.
+ *
+ *    avi::parallel::pipelined(avi::stream::int_stream::open("-"),
+ *                             avi::batch::filter(is_even)
+ *                             | avi::batch::transform(inc),
+ *                             [&](int v) { out.put(v, 2); });
+ *
+ *  Elements reach the sink in source order.  batch::reverse needs
+ *  the whole input and is not accepted here.  An exception from
+ *  the source, a stage or the sink stops every thread and is
+ *  rethrown.
+ */
+template <std::ranges::input_range R, typename P, typename Sink>
+  requires batch::detail::stage_like<P>
+void pipelined(R && src, P stages, Sink sink, pipelined_options opts = {}) {
+  using stage_tuple = decltype(batch::detail::as_tuple(std::move(stages)));
+  using pipe_type = typename batch::detail::pipeline_from<stage_tuple>::type;
+  using in_type = std::ranges::range_value_t<R>;
+  using out_type = typename pipe_type::template output_t<in_type>;
+  using rings_type = typename detail::rings_for<in_type, stage_tuple>::type;
+  constexpr auto stage_count = std::tuple_size_v<stage_tuple>;
+
+  static_assert(!pipe_type::reversed,
+                "avi::parallel::pipelined: reverse needs the whole input");
+
+  auto const bs = std::max<std::size_t>(opts.batch_size, 1);
+  auto const cap = std::max(opts.ring_capacity, bs);
+  auto each = batch::detail::as_tuple(std::move(stages));
+
+  auto rings = [&]<std::size_t... I>(std::index_sequence<I...>) {
+    return rings_type((static_cast<void>(I), cap)...);
+  }(std::make_index_sequence<stage_count + 1>());
+  auto failed = detail::failure {};
+
+  {
+    auto threads = std::vector<std::jthread>();
+    threads.reserve(stage_count + 1);
+
+    threads.emplace_back([&] {
+      auto & out = std::get<0>(rings);
+      try {
+        auto batch = std::vector<in_type>();
+        batch.reserve(bs);
+        for (auto && v : src) {
+          batch.push_back(std::forward<decltype(v)>(v));
+          if (batch.size() == bs) {
+            if (!out.push(batch.data(), bs)) { break; }
+            batch.clear();
+          }
+        }
+        out.push(batch.data(), batch.size());
+      }
+      catch (...) {
+        failed.record(rings);
+      }
+      out.close();
+    });
+
+    [&]<std::size_t... I>(std::index_sequence<I...>) {
+      (threads.emplace_back([&] {
+        auto & out = std::get<I + 1>(rings);
+        try {
+          detail::run_stage(std::get<I>(each), std::get<I>(rings), out, bs);
+        }
+        catch (...) {
+          failed.record(rings);
+          out.close();
+        }
+      }), ...);
+    }(std::make_index_sequence<stage_count>());
+
+    auto & in = std::get<stage_count>(rings);
+    try {
+      auto batch = std::vector<out_type>(bs);
+      for (auto n = in.pop(batch.data(), bs); n != 0; n = in.pop(batch.data(), bs)) {
+        for (auto j = std::size_t { 0 }; j < n; ++j) {
+          sink(batch[j]);
+        }
+      }
+    }
+    catch (...) {
+      failed.record(rings);
+    }
+  }
+
+  failed.rethrow();
+  return;
+}
+
+} /* namespace parallel */
+} /* namespace avi */
+
+#endif /* stage_pipeline_h */
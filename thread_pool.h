@@ -0,0 +1,393 @@
+//
+//  thread_pool.h
+//  CF.STL_Ranges_00
+//
+//  Process-wide work-stealing thread pool that the parallel range
+//  algorithms run on.
+//
+
+#ifndef thread_pool_h
+#define thread_pool_h
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace avi {
+namespace parallel {
+
+//  MARK: - Configuration
+inline
+auto worker_count(void) -> std::size_t {
+  auto const hc = std::thread::hardware_concurrency();
+  return hc == 0 ? 1 : static_cast<std::size_t>(hc);
+}
+
+/*
+ *  Data written by different threads (chunk boundaries, ring
+ *  indices, deque ends) is kept this many bytes apart so that no
+ *  two workers ever write to the same cache line.
+ */
+inline constexpr std::size_t cache_line = 64;
+
+namespace detail {
+
+//  MARK: - Chase-Lev Deque
+/*
+ *  Fixed-capacity work-stealing deque (Chase and Lev, with the
+ *  C11 memory orderings of Lê et al.).  The owning thread push()es
+ *  and pop()s at the bottom, LIFO, so it keeps working on the
+ *  most recently split (and cache-warm) piece; any other thread
+ *  may steal() the oldest, largest piece from the top.  A full
+ *  deque refuses the push and the owner runs the job itself.
+ */
+template <typename T>
+class ws_deque {
+public:
+  static constexpr std::int64_t capacity = 1024;
+
+  auto push(T * job) -> bool {
+    auto const b = bottom_.load(std::memory_order_relaxed);
+    auto const t = top_.load(std::memory_order_acquire);
+    if (b - t >= capacity) { return false; }
+    slots_[static_cast<std::size_t>(b & (capacity - 1))].store(job, std::memory_order_relaxed);
+    bottom_.store(b + 1, std::memory_order_release);
+    return true;
+  }
+
+  auto pop(void) -> T * {
+    auto const b = bottom_.load(std::memory_order_relaxed) - 1;
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto t = top_.load(std::memory_order_relaxed);
+    if (t > b) {
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+
+    auto * job = slots_[static_cast<std::size_t>(b & (capacity - 1))].load(std::memory_order_relaxed);
+    if (t == b) {
+      // Last job: race any thief for it
+      if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                        std::memory_order_relaxed)) {
+        job = nullptr;
+      }
+      bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+    return job;
+  }
+
+  auto steal(void) -> T * {
+    auto t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto const b = bottom_.load(std::memory_order_acquire);
+    if (t >= b) { return nullptr; }
+
+    auto * job = slots_[static_cast<std::size_t>(t & (capacity - 1))].load(std::memory_order_relaxed);
+    if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      return nullptr;
+    }
+    return job;
+  }
+
+private:
+  alignas(cache_line) std::atomic<std::int64_t> top_ { 0 };
+  alignas(cache_line) std::atomic<std::int64_t> bottom_ { 0 };
+  alignas(cache_line) std::array<std::atomic<T *>, capacity> slots_ {};
+};
+
+/*
+ *  A half-open range of indices waiting to be run by whichever
+ *  thread gets to it.  Jobs live on the stack of the thread that
+ *  split them off, which does not return until done is set.
+ */
+struct range_job {
+  struct context * ctx = nullptr;
+  std::size_t first = 0;
+  std::size_t last = 0;
+  std::atomic<bool> done { false };
+};
+
+/*
+ *  One parallel_for() call: the type-erased body, the grain it is
+ *  split down to, and the first exception any piece threw.
+ */
+struct context {
+  void const * body = nullptr;
+  void (*invoke)(void const *, std::size_t, std::size_t) = nullptr;
+  std::size_t grain = 1;
+  std::atomic<bool> failed { false };
+  std::mutex mutex;
+  std::exception_ptr error;
+
+  void run(std::size_t first, std::size_t last) noexcept {
+    if (failed.load(std::memory_order_relaxed)) { return; }
+    try {
+      invoke(body, first, last);
+    }
+    catch (...) {
+      auto lock = std::lock_guard(mutex);
+      if (!error) { error = std::current_exception(); }
+      failed.store(true, std::memory_order_relaxed);
+    }
+  }
+};
+
+} /* namespace detail */
+
+//  MARK: - Thread Pool
+/*
+ *  thread_pool
+ *
+ *  worker_count() - 1 threads, started once and kept for the life
+ *  of the process (see pool()); the thread that calls
+ *  parallel_for() makes up the last worker.  Every worker owns a
+ *  Chase-Lev deque.  A range is split in half repeatedly: the
+ *  upper halves are pushed for others to steal and the lowest
+ *  piece is run in place.  Idle workers steal from randomly chosen
+ *  victims, so a piece that turns out slow (a filter that keeps
+ *  far more than average, say) is worked around instead of
+ *  holding everyone up.  After a short spin with nothing to steal
+ *  a worker parks on an atomic wait until new work is pushed.
+ *
+ *  Threads outside the pool borrow one of a few external deques
+ *  for the duration of the call; if none is free the call runs
+ *  serially.  parallel_for() may be nested and called from
+ *  several threads at once.
+ */
+class thread_pool {
+public:
+  explicit thread_pool(std::size_t threads)
+    : slots_(threads + external_slots) {
+    workers_.reserve(threads);
+    for (auto w = std::size_t { 0 }; w < threads; ++w) {
+      workers_.emplace_back([this, w] { work(w); });
+    }
+  }
+
+  thread_pool(thread_pool const &) = delete;
+  auto operator=(thread_pool const &) -> thread_pool & = delete;
+
+  ~thread_pool() {
+    stop_.store(true, std::memory_order_seq_cst);
+    epoch_.fetch_add(1, std::memory_order_seq_cst);
+    epoch_.notify_all();
+    workers_.clear();
+  }
+
+  auto size(void) const -> std::size_t { return workers_.size() + 1; }
+
+  /*
+   *  body(first, last) over pieces of [first, last) no smaller
+   *  than grain (except at the end), in parallel, returning when
+   *  all are done.  The first exception thrown by body stops
+   *  further pieces from starting and is rethrown here.
+   */
+  template <typename Body>
+  void parallel_for(std::size_t first, std::size_t last, std::size_t grain, Body && body) {
+    if (first >= last) { return; }
+
+    auto ctx = detail::context {};
+    ctx.body = std::addressof(body);
+    ctx.invoke = [](void const * b, std::size_t lo, std::size_t hi) {
+      (*static_cast<std::remove_reference_t<Body> *>(const_cast<void *>(b)))(lo, hi);
+    };
+    ctx.grain = std::max<std::size_t>(grain, 1);
+
+    if (workers_.empty() || last - first <= ctx.grain) {
+      ctx.run(first, last);
+    }
+    else {
+      auto const claim = external_claim(this);
+      if (current_ != nullptr) {
+        run_range(ctx, first, last);
+      }
+      else {
+        ctx.run(first, last);
+      }
+    }
+
+    if (ctx.error) { std::rethrow_exception(ctx.error); }
+    return;
+  }
+
+private:
+  static constexpr std::size_t external_slots = 4;
+
+  struct alignas(cache_line) slot {
+    detail::ws_deque<detail::range_job> deque;
+    std::atomic<bool> claimed { false };
+    std::uint64_t seed = 0;
+  };
+
+  /*
+   *  Gives a thread from outside the pool a deque of its own while
+   *  it is inside parallel_for().  Pool workers (and nested calls)
+   *  already have one.
+   */
+  struct external_claim {
+    explicit external_claim(thread_pool * pool) {
+      if (current_ != nullptr) { return; }
+      auto & slots = pool->slots_;
+      for (auto i = pool->workers_.size(); i < slots.size(); ++i) {
+        auto expected = false;
+        if (slots[i].claimed.compare_exchange_strong(expected, true)) {
+          owned = &slots[i];
+          owned->seed = i + 1;
+          current_ = owned;
+          return;
+        }
+      }
+    }
+
+    ~external_claim() {
+      if (owned != nullptr) {
+        current_ = nullptr;
+        owned->claimed.store(false, std::memory_order_release);
+      }
+    }
+
+    external_claim(external_claim const &) = delete;
+    auto operator=(external_claim const &) -> external_claim & = delete;
+
+    slot * owned = nullptr;
+  };
+
+  /*
+   *  Split off upper halves until the piece is down to the grain,
+   *  run it, then wait for the halves, running them here unless a
+   *  thief got there first; while a stolen half is still running,
+   *  help with whatever else there is to do.
+   */
+  void run_range(detail::context & ctx, std::size_t first, std::size_t last) {
+    auto jobs = std::array<detail::range_job, 64> {};
+    auto spawned = std::size_t { 0 };
+    while (last - first > ctx.grain && spawned < jobs.size()) {
+      auto const mid = first + (last - first) / 2;
+      auto & job = jobs[spawned];
+      job.ctx = &ctx;
+      job.first = mid;
+      job.last = last;
+      if (!current_->deque.push(&job)) { break; }
+      ++spawned;
+      last = mid;
+      announce();
+    }
+
+    ctx.run(first, last);
+
+    while (spawned != 0) {
+      auto & job = jobs[--spawned];
+      while (!job.done.load(std::memory_order_acquire)) {
+        if (auto * next = current_->deque.pop()) {
+          execute(next);
+        }
+        else if (auto * stolen = steal()) {
+          execute(stolen);
+        }
+        else {
+          std::this_thread::yield();
+        }
+      }
+    }
+    return;
+  }
+
+  void execute(detail::range_job * job) {
+    run_range(*job->ctx, job->first, job->last);
+    job->done.store(true, std::memory_order_release);
+  }
+
+  /*
+   *  One pass over every other deque, starting at a random one.
+   */
+  auto steal(void) -> detail::range_job * {
+    auto & self = *current_;
+    self.seed ^= self.seed << 13;
+    self.seed ^= self.seed >> 7;
+    self.seed ^= self.seed << 17;
+    auto const n = slots_.size();
+    auto const start = static_cast<std::size_t>(self.seed % n);
+    for (auto i = std::size_t { 0 }; i < n; ++i) {
+      auto & victim = slots_[(start + i) % n];
+      if (&victim == &self) { continue; }
+      if (auto * job = victim.deque.steal()) { return job; }
+    }
+    return nullptr;
+  }
+
+  /*
+   *  New work was pushed: wake a parked worker, if there is one.
+   */
+  void announce(void) {
+    epoch_.fetch_add(1, std::memory_order_seq_cst);
+    if (sleepers_.load(std::memory_order_seq_cst) != 0) {
+      epoch_.notify_one();
+    }
+  }
+
+  void work(std::size_t index) {
+    current_ = &slots_[index];
+    current_->seed = index + 0x9e3779b97f4a7c15ull;
+    while (!stop_.load(std::memory_order_acquire)) {
+      if (auto * job = find_work()) {
+        execute(job);
+        continue;
+      }
+
+      // Nothing found after reading epoch: anything pushed since
+      // bumps it and cuts the wait short
+      auto const seen = epoch_.load(std::memory_order_seq_cst);
+      if (auto * job = find_work()) {
+        execute(job);
+        continue;
+      }
+      if (stop_.load(std::memory_order_acquire)) { break; }
+      sleepers_.fetch_add(1, std::memory_order_seq_cst);
+      epoch_.wait(seen, std::memory_order_seq_cst);
+      sleepers_.fetch_sub(1, std::memory_order_seq_cst);
+    }
+    current_ = nullptr;
+  }
+
+  auto find_work(void) -> detail::range_job * {
+    for (auto round = 0; round < 64; ++round) {
+      if (auto * job = current_->deque.pop()) { return job; }
+      if (auto * job = steal()) { return job; }
+      if (round >= 16) { std::this_thread::yield(); }
+    }
+    return nullptr;
+  }
+
+  static inline thread_local slot * current_ = nullptr;
+
+  std::vector<slot> slots_;
+  alignas(cache_line) std::atomic<std::uint64_t> epoch_ { 0 };
+  alignas(cache_line) std::atomic<std::size_t> sleepers_ { 0 };
+  std::atomic<bool> stop_ { false };
+  std::vector<std::jthread> workers_;
+};
+
+/*
+ *  The process-wide pool, started on first use.
+ */
+inline
+auto pool(void) -> thread_pool & {
+  static auto instance = thread_pool(worker_count() - 1);
+  return instance;
+}
+
+} /* namespace parallel */
+} /* namespace avi */
+
+#endif /* thread_pool_h */
@@ -0,0 +1,284 @@
+//
+//  top_k.h
+//  CF.STL_Ranges_00
+//
+//  Top-k terminal: the k best elements of a range without sorting
+//  all of it.
+//
+
+#ifndef top_k_h
+#define top_k_h
+
+#include <algorithm>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "parallel_pipeline.h"
+#include "reduce.h"
+
+#if defined(__AVX2__)
+#   include <immintrin.h>
+#endif
+
+namespace avi {
+namespace top {
+
+namespace detail {
+
+//  MARK: - Bounded Heap
+/*
+ *  The best k elements seen so far, as a heap whose front is the
+ *  worst of them: once the heap is full, a new element is kept
+ *  only if it beats the front, which is one compare for the great
+ *  majority that do not.
+ */
+template <typename T, typename Comp>
+class bounded_heap {
+public:
+  bounded_heap(std::size_t k, Comp const & comp) : k_(k), comp_(comp) {}
+
+  auto full(void) const -> bool { return heap_.size() == k_; }
+  auto threshold(void) const -> T const & { return heap_.front(); }
+
+  /*
+   *  Whether offer(v) could change the heap.
+   */
+  auto wants(T const & v) const -> bool {
+    return heap_.size() < k_ || (k_ != 0 && std::invoke(comp_, v, heap_.front()));
+  }
+
+  void offer(T const & v) {
+    if (heap_.size() < k_) {
+      heap_.push_back(v);
+      std::ranges::push_heap(heap_, comp_);
+    }
+    else if (k_ != 0 && std::invoke(comp_, v, heap_.front())) {
+      std::ranges::pop_heap(heap_, comp_);
+      heap_.back() = v;
+      std::ranges::push_heap(heap_, comp_);
+    }
+  }
+
+  auto take(void) -> std::vector<T> { return std::move(heap_); }
+
+private:
+  std::size_t k_;
+  Comp comp_;
+  std::vector<T> heap_;
+};
+
+/*
+ *  The threshold is tested before the predicate: it rejects nearly
+ *  everything once the heap has filled, and does so predictably,
+ *  while a filter's outcome is often a coin toss.
+ */
+template <typename I, typename S, typename T, typename Comp, typename Pred>
+void offer_all(I first, S last, bounded_heap<T, Comp> & heap, Pred const & pred) {
+  for (; first != last; ++first) {
+    T const & v = *first;
+    if (heap.wants(v) && std::invoke(pred, v)) { heap.offer(v); }
+  }
+}
+
+//  MARK: - SIMD Pre-filter
+#if defined(__AVX2__)
+template <typename Comp>
+inline constexpr bool keeps_largest =
+  std::same_as<Comp, std::ranges::greater> || std::same_as<Comp, std::greater<>>
+  || std::same_as<Comp, std::greater<int>>;
+
+template <typename Comp>
+inline constexpr bool keeps_smallest =
+  std::same_as<Comp, std::ranges::less> || std::same_as<Comp, std::less<>>
+  || std::same_as<Comp, std::less<int>>;
+
+/*
+ *  Once the heap is full, eight ints at a time are compared with
+ *  its threshold (and narrowed by the predicate's lane mask, if it
+ *  has one); a register with no candidate is skipped outright.
+ *  Candidates are offered one by one, which rechecks them against
+ *  a threshold that may have tightened since.
+ */
+template <typename Comp, typename Pred>
+void offer_simd(int const * p, std::size_t n, bounded_heap<int, Comp> & heap, Pred const & pred) {
+  auto i = std::size_t { 0 };
+  for (; i < n && !heap.full(); ++i) {
+    if (std::invoke(pred, p[i])) { heap.offer(p[i]); }
+  }
+
+  for (; i + 8 <= n; i += 8) {
+    auto const v = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(p + i));
+    auto const t = _mm256_set1_epi32(heap.threshold());
+    auto m = __m256i {};
+    if constexpr (keeps_largest<Comp>) { m = _mm256_cmpgt_epi32(v, t); }
+    else { m = _mm256_cmpgt_epi32(t, v); }
+    m = _mm256_and_si256(m, reduce::detail::lane_mask(pred, v));
+    for (auto bits = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(m)));
+         bits != 0; bits &= bits - 1) {
+      heap.offer(p[i + static_cast<std::size_t>(std::countr_zero(bits))]);
+    }
+  }
+  offer_all(p + i, p + n, heap, pred);
+}
+#endif
+
+/*
+ *  Offer the chunk [lo, hi) of a random-access source.
+ */
+template <typename T, typename Comp, typename Src, typename Pred>
+void offer_chunk(Src & src, std::size_t lo, std::size_t hi,
+                 bounded_heap<T, Comp> & heap, Pred const & pred) {
+#if defined(__AVX2__)
+  if constexpr (std::ranges::contiguous_range<Src>
+                && std::same_as<std::ranges::range_value_t<Src>, int>
+                && std::same_as<T, int>
+                && (keeps_largest<Comp> || keeps_smallest<Comp>)
+                && reduce::detail::has_lane_mask<Pred>) {
+    offer_simd(std::ranges::data(src) + lo, hi - lo, heap, pred);
+    return;
+  }
+#endif
+  auto const first = std::ranges::begin(src);
+  offer_all(first + static_cast<std::ptrdiff_t>(lo), first + static_cast<std::ptrdiff_t>(hi),
+            heap, pred);
+}
+
+//  MARK: - Driver
+/*
+ *  One heap per worker over a contiguous share of the source, then
+ *  the survivors (at most k per worker) merged into one heap.
+ */
+template <typename T, typename Comp, typename Src, typename Pred>
+auto select_parallel(Src & src, std::size_t k, Comp const & comp, Pred const & pred)
+    -> std::vector<T> {
+  auto const n = static_cast<std::size_t>(std::ranges::size(src));
+  auto const parts = std::min(parallel::chunk_count(n), parallel::worker_count());
+  auto survivors = std::vector<std::vector<T>>(parts);
+  parallel::for_each_chunk(parts, [&](std::size_t c) {
+    auto heap = bounded_heap<T, Comp>(k, comp);
+    offer_chunk(src, n * c / parts, n * (c + 1) / parts, heap, pred);
+    survivors[c] = heap.take();
+  });
+
+  if (parts == 1) { return std::move(survivors[0]); }
+  auto heap = bounded_heap<T, Comp>(k, comp);
+  for (auto const & s : survivors) {
+    for (auto const & v : s) { heap.offer(v); }
+  }
+  return heap.take();
+}
+
+/*
+ *  One heap over the whole source, on the calling thread.
+ */
+template <typename T, typename Comp, typename Src, typename Pred>
+auto select_serial(Src & src, std::size_t k, Comp const & comp, Pred const & pred)
+    -> std::vector<T> {
+  auto heap = bounded_heap<T, Comp>(k, comp);
+  offer_chunk(src, 0, static_cast<std::size_t>(std::ranges::size(src)), heap, pred);
+  return heap.take();
+}
+
+/*
+ *  The best k of rng, in no particular order:
+ *
+ *    sized random-access                              in parallel
+ *    views::filter over a sized random-access base    in parallel,
+ *        the predicate applied while scanning
+ *    anything else                                    in one pass
+ *
+ *  sequential scans the first two in one pass as well.
+ */
+template <typename Comp, std::ranges::input_range R>
+auto select(R && rng, std::size_t k, Comp const & comp, bool sequential)
+    -> std::vector<std::ranges::range_value_t<R>> {
+  using value_type = std::ranges::range_value_t<R>;
+
+  if (k == 0) { return {}; }
+  if constexpr (std::ranges::random_access_range<R> && std::ranges::sized_range<R>) {
+    if (sequential) {
+      return select_serial<value_type>(rng, k, comp, reduce::detail::keep_all {});
+    }
+    return select_parallel<value_type>(rng, k, comp, reduce::detail::keep_all {});
+  }
+  else if constexpr (reduce::detail::splittable_filter<R>) {
+    auto base = rng.base();
+    if (sequential) { return select_serial<value_type>(base, k, comp, rng.pred()); }
+    return select_parallel<value_type>(base, k, comp, rng.pred());
+  }
+  else {
+    auto heap = bounded_heap<value_type, Comp>(k, comp);
+    offer_all(std::ranges::begin(rng), std::ranges::end(rng), heap, reduce::detail::keep_all {});
+    return heap.take();
+  }
+}
+
+} /* namespace detail */
+
+//  MARK: - Terminal
+template <typename Comp>
+struct top_k_closure {
+  std::size_t k;
+  Comp comp;
+  bool sequential = false;
+
+  template <std::ranges::input_range R>
+    requires std::indirect_strict_weak_order<Comp const, std::ranges::iterator_t<R>>
+  auto operator()(R && rng) const {
+    auto best = detail::select(std::forward<R>(rng), k, comp, sequential);
+    std::ranges::sort(best, comp);
+    return best;
+  }
+
+  template <std::ranges::input_range R>
+  friend auto operator|(R && rng, top_k_closure const & self) {
+    return self(std::forward<R>(rng));
+  }
+};
+
+} /* namespace top */
+
+/*
+ *  top_k(k [, comp])
+ *
+ *  Pipe terminal returning the first k elements a sort by comp
+ *  would produce, in that order (fewer if the range is shorter):
+ *
+ *    auto best = numbers
+ *         | views::filter(is_even)
+ *         | avi::top_k(100);                      // 100 largest
+ *    auto least = numbers | avi::top_k(5, std::ranges::less {});
+ *
+ *  comp defaults to std::ranges::greater, so the largest come
+ *  first.  Only k elements are ever held per worker, in a bounded
+ *  heap, and merged at the end.  Sized random-access ranges, and
+ *  views::filter over one, are split across the pool; contiguous
+ *  ints with std::ranges::greater or less are pre-filtered eight
+ *  at a time against the heap's threshold with AVX2.
+ *
+ *  Split across the pool, comp, the filter's predicate and any
+ *  transform behind a random-access range run on several threads
+ *  at once: they must be thread-safe and free of side effects.
+ *  top_k(seq, k [, comp]) selects on the calling thread alone.
+ */
+template <typename Comp = std::ranges::greater>
+auto top_k(std::size_t k, Comp comp = {}) -> top::top_k_closure<Comp> {
+  return { k, std::move(comp) };
+}
+
+template <typename Comp = std::ranges::greater>
+auto top_k(parallel::sequenced_policy, std::size_t k, Comp comp = {})
+    -> top::top_k_closure<Comp> {
+  return { k, std::move(comp), true };
+}
+
+} /* namespace avi */
+
+#endif /* top_k_h */